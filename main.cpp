@@ -3,24 +3,934 @@
 #include <limits>
 #include <vector>
 #include <fstream>
+#include <unordered_map>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+#include <chrono>
+#include <sstream>
+#include <string_view>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <charconv>
+#include <random>
+#include <deque>
+#include <condition_variable>
+#include <new>
+#include <memory>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/wait.h>
+#include <dirent.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
 
 using namespace std;
+
+/** @brief Сколько раз текущий поток выделял память через new (бенчмарк считает выделения на операцию) */
+inline thread_local size_t threadAllocations = 0;
+
+void* operator new(size_t size) {
+    ++threadAllocations;
+    if (size == 0) size = 1;
+    while (true) {
+        if (void* p = malloc(size)) return p;
+        new_handler handler = get_new_handler();
+        if (!handler) throw bad_alloc();
+        handler();
+    }
+}
+
+void* operator new(size_t size, align_val_t align) {
+    ++threadAllocations;
+    size_t a = static_cast<size_t>(align);
+    size = size == 0 ? a : (size + a - 1) / a * a; // aligned_alloc хочет размер, кратный выравниванию
+    while (true) {
+        if (void* p = aligned_alloc(a, size)) return p;
+        new_handler handler = get_new_handler();
+        if (!handler) throw bad_alloc();
+        handler();
+    }
+}
+
+// noinline: иначе gcc видит free() против operator new и ругается на несовпадение пар
+__attribute__((noinline)) void operator delete(void* p) noexcept { free(p); }
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept { free(p); }
+__attribute__((noinline)) void operator delete(void* p, align_val_t) noexcept { free(p); }
+__attribute__((noinline)) void operator delete(void* p, size_t, align_val_t) noexcept { free(p); }
+
+// ---- метрики: по умолчанию собираются, -DUNI_METRICS=0 вырезает запись из горячих путей целиком ----
+#ifndef UNI_METRICS
+#define UNI_METRICS 1
+#endif
+
+/** @brief Что меряем: операции предметной области, поиски и служебные действия */
+enum class Metric : uint8_t {
+    AddTeacher, AddStudent, AddSubject, Enroll, EnrollGroup, AddWork,
+    Reserve, Submit, Approve, Reject, Drop,
+    FindStudent, FindTeacher, FindSubject, SlotLookup,
+    ShowActivity, ShowSubject, Export, ExportAll, Stats, Import, Search,
+    Snapshot, JournalCommit, BatchCommand, Request,
+    Count
+};
+const size_t METRIC_COUNT = static_cast<size_t>(Metric::Count);
+const char* const METRIC_NAMES[METRIC_COUNT] = {
+    "add_teacher", "add_student", "add_subject", "enroll", "enroll_group", "add_work",
+    "reserve", "submit", "approve", "reject", "drop",
+    "find_student", "find_teacher", "find_subject", "slot_lookup",
+    "show_activity", "show_subject", "export", "export_all", "stats", "import", "search",
+    "snapshot", "journal_commit", "batch_command", "request"};
+const size_t METRIC_BUCKETS = 22; // задержки: корзина b - до 2^(b+8) нс, последняя - всё остальное
+const char* const METRICS_FILE = "university.metrics";
+const int METRICS_DUMP_SECONDS = 10;
+
+namespace metrics {
+    /** @brief Счётчики одного потока: пишет только владелец, читают все (relaxed, без блокировок) */
+    struct Shard {
+        atomic<uint64_t> calls[METRIC_COUNT] = {};
+        atomic<uint64_t> nanos[METRIC_COUNT] = {};
+        atomic<uint64_t> allocs[METRIC_COUNT] = {};
+        atomic<uint64_t> probes[METRIC_COUNT] = {};
+        atomic<uint64_t> buckets[METRIC_COUNT][METRIC_BUCKETS] = {};
+    };
+
+    // единственный писатель - поток-владелец, поэтому хватает load+store без блокирующего RMW
+    inline void bump(atomic<uint64_t>& cell, uint64_t by) {
+        cell.store(cell.load(memory_order_relaxed) + by, memory_order_relaxed);
+    }
+
+    /** @brief Все осколки; поток берёт свой при первой записи и возвращает при выходе.
+     *  Счёт в возвращённом осколке остаётся, его продолжает следующий поток - осколков не больше,
+     *  чем потоков жило одновременно, сколько бы пулов ни запускали */
+    class Registry {
+        private:
+        mutable mutex lock;
+        vector<unique_ptr<Shard>> shards;
+        vector<Shard*> idle; // осколки завершившихся потоков
+        inline static thread_local Shard* mine = nullptr;
+
+        // отдаёт осколок потока обратно, когда поток завершается
+        struct Lease {
+            Registry* owner = nullptr;
+            ~Lease() {
+                if (owner && mine) owner->release(mine);
+                mine = nullptr;
+            }
+        };
+
+        Shard* acquire() {
+            thread_local Lease lease;
+            lease.owner = this;
+            lock_guard<mutex> guard(lock);
+            if (!idle.empty()) {
+                Shard* shard = idle.back();
+                idle.pop_back();
+                return shard;
+            }
+            shards.push_back(make_unique<Shard>());
+            return shards.back().get();
+        }
+        void release(Shard* shard) {
+            lock_guard<mutex> guard(lock);
+            idle.push_back(shard);
+        }
+
+        public:
+        Shard& local() {
+            if (!mine) mine = acquire();
+            return *mine;
+        }
+        // сумма по всем осколкам; threads - сколько из них сейчас заняты живыми потоками
+        void collect(Shard& total, size_t& threads) const {
+            lock_guard<mutex> guard(lock);
+            threads = shards.size() - idle.size();
+            for (const auto& s : shards) {
+                for (size_t m = 0; m < METRIC_COUNT; ++m) {
+                    bump(total.calls[m], s->calls[m].load(memory_order_relaxed));
+                    bump(total.nanos[m], s->nanos[m].load(memory_order_relaxed));
+                    bump(total.allocs[m], s->allocs[m].load(memory_order_relaxed));
+                    bump(total.probes[m], s->probes[m].load(memory_order_relaxed));
+                    for (size_t b = 0; b < METRIC_BUCKETS; ++b) {
+                        bump(total.buckets[m][b], s->buckets[m][b].load(memory_order_relaxed));
+                    }
+                }
+            }
+        }
+    };
+
+    inline Registry& registry() {
+        static Registry r;
+        return r;
+    }
+
+    inline size_t bucketOf(uint64_t ns) {
+        size_t bits = 64 - static_cast<size_t>(__builtin_clzll(ns | 1));
+        return bits <= 8 ? 0 : min(bits - 8, METRIC_BUCKETS - 1);
+    }
+
+    inline void count(Metric m, uint64_t probes = 0) {
+        Shard& s = registry().local();
+        size_t i = static_cast<size_t>(m);
+        bump(s.calls[i], 1);
+        if (probes) bump(s.probes[i], probes);
+    }
+
+    /** @brief Меряет вызов от конструктора до деструктора: время, корзина гистограммы, выделения памяти */
+    class ScopedTimer {
+        private:
+        size_t index;
+        size_t allocsAtStart;
+        chrono::steady_clock::time_point start;
+
+        public:
+        explicit ScopedTimer(Metric m)
+            : index(static_cast<size_t>(m)), allocsAtStart(threadAllocations), start(chrono::steady_clock::now()) {}
+        ~ScopedTimer() {
+            uint64_t ns = static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count());
+            Shard& s = registry().local();
+            bump(s.calls[index], 1);
+            bump(s.nanos[index], ns);
+            bump(s.allocs[index], threadAllocations - allocsAtStart);
+            bump(s.buckets[index][bucketOf(ns)], 1);
+        }
+        ScopedTimer(const ScopedTimer&) = delete;
+        ScopedTimer& operator=(const ScopedTimer&) = delete;
+    };
+
+    // верхняя граница корзины, в которую попал квантиль p (0 - если вызовов не было)
+    inline uint64_t percentileBound(const Shard& s, size_t m, double p) {
+        uint64_t n = s.calls[m].load(memory_order_relaxed), seen = 0;
+        uint64_t want = static_cast<uint64_t>(p * static_cast<double>(n));
+        for (size_t b = 0; b < METRIC_BUCKETS; ++b) {
+            seen += s.buckets[m][b].load(memory_order_relaxed);
+            if (seen > want) return uint64_t(1) << (b + 8);
+        }
+        return 0;
+    }
+
+    // человеку: по строке на каждую операцию, у которой были вызовы
+    inline void printReport() {
+        if (!UNI_METRICS) {
+            cout << "метрики выключены при сборке (UNI_METRICS=0)\n";
+            return;
+        }
+        Shard total;
+        size_t threads = 0;
+        registry().collect(total, threads);
+        cout << "метрики (потоков: " << threads << "):\n";
+        bool any = false;
+        for (size_t m = 0; m < METRIC_COUNT; ++m) {
+            uint64_t calls = total.calls[m].load(memory_order_relaxed);
+            if (calls == 0) continue;
+            any = true;
+            cout << "  " << METRIC_NAMES[m] << ": вызовов " << calls;
+            uint64_t nanos = total.nanos[m].load(memory_order_relaxed);
+            if (nanos) {
+                cout << ", среднее " << nanos / calls << " нс, p50 до " << percentileBound(total, m, 0.50)
+                     << " нс, p99 до " << percentileBound(total, m, 0.99) << " нс";
+                char allocs[32];
+                snprintf(allocs, sizeof(allocs), "%.2f", static_cast<double>(total.allocs[m].load(memory_order_relaxed)) / calls);
+                cout << ", выделений на вызов " << allocs;
+            }
+            uint64_t probes = total.probes[m].load(memory_order_relaxed);
+            if (probes) {
+                char avg[32];
+                snprintf(avg, sizeof(avg), "%.2f", static_cast<double>(probes) / calls);
+                cout << ", проб на поиск " << avg;
+            }
+            cout << "\n";
+        }
+        if (!any) cout << "  пока ничего не вызывалось\n";
+    }
+
+    // текстовый формат Prometheus
+    inline void formatPrometheus(string& out) {
+        Shard total;
+        size_t threads = 0;
+        registry().collect(total, threads);
+        char num[64];
+        auto family = [&](const char* name, const char* type, const char* help) {
+            out += "# HELP ";
+            out += name;
+            out += ' ';
+            out += help;
+            out += "\n# TYPE ";
+            out += name;
+            out += ' ';
+            out += type;
+            out += '\n';
+        };
+        auto sample = [&](const char* name, size_t m, const char* extra, uint64_t value) {
+            out += name;
+            out += "{op=\"";
+            out += METRIC_NAMES[m];
+            out += '"';
+            out += extra;
+            out += "} ";
+            out += to_string(value);
+            out += '\n';
+        };
+        family("uni_op_calls_total", "counter", "Вызовы операции");
+        for (size_t m = 0; m < METRIC_COUNT; ++m) sample("uni_op_calls_total", m, "", total.calls[m].load(memory_order_relaxed));
+        family("uni_op_allocations_total", "counter", "Выделения памяти внутри операции");
+        for (size_t m = 0; m < METRIC_COUNT; ++m) {
+            if (total.nanos[m].load(memory_order_relaxed)) {
+                sample("uni_op_allocations_total", m, "", total.allocs[m].load(memory_order_relaxed));
+            }
+        }
+        family("uni_lookup_probes_total", "counter", "Пробы при поиске");
+        for (size_t m = 0; m < METRIC_COUNT; ++m) {
+            if (total.probes[m].load(memory_order_relaxed)) {
+                sample("uni_lookup_probes_total", m, "", total.probes[m].load(memory_order_relaxed));
+            }
+        }
+        family("uni_op_latency_seconds", "histogram", "Задержка операции");
+        for (size_t m = 0; m < METRIC_COUNT; ++m) {
+            uint64_t nanos = total.nanos[m].load(memory_order_relaxed);
+            if (!nanos) continue;
+            uint64_t cumulative = 0;
+            for (size_t b = 0; b < METRIC_BUCKETS; ++b) {
+                cumulative += total.buckets[m][b].load(memory_order_relaxed);
+                string le = ",le=\"";
+                if (b + 1 < METRIC_BUCKETS) {
+                    snprintf(num, sizeof(num), "%g", static_cast<double>(uint64_t(1) << (b + 8)) / 1e9);
+                    le += num;
+                } else {
+                    le += "+Inf";
+                }
+                le += '"';
+                sample("uni_op_latency_seconds_bucket", m, le.c_str(), cumulative);
+            }
+            snprintf(num, sizeof(num), "%.9f", static_cast<double>(nanos) / 1e9);
+            out += "uni_op_latency_seconds_sum{op=\"";
+            out += METRIC_NAMES[m];
+            out += "\"} ";
+            out += num;
+            out += '\n';
+            sample("uni_op_latency_seconds_count", m, "", total.calls[m].load(memory_order_relaxed));
+        }
+        family("uni_metric_threads", "gauge", "Живые потоки, пишущие метрики");
+        out += "uni_metric_threads " + to_string(threads) + "\n";
+    }
+}
+
+#if UNI_METRICS
+#define METRIC_CONCAT_(a, b) a##b
+#define METRIC_CONCAT(a, b) METRIC_CONCAT_(a, b)
+#define METRIC_TIME(m) metrics::ScopedTimer METRIC_CONCAT(metricTimer, __LINE__)(Metric::m)
+#define METRIC_COUNT_CALL(m) metrics::count(Metric::m)
+#define METRIC_PROBES(m, n) metrics::count(Metric::m, (n))
+#else
+#define METRIC_TIME(m) ((void)0)
+#define METRIC_COUNT_CALL(m) ((void)0)
+#define METRIC_PROBES(m, n) ((void)0)
+#endif
+
+/** @brief Тихий режим потока: подтверждения операций предметной области не выводятся */
+inline thread_local bool quietOutput = false;
+
+/** @brief Болтовня предметной области (подтверждения операций); в тихом режиме даже не форматируется */
+inline ostream& chatter() {
+    thread_local ostream muted(nullptr); // без буфера поток сразу в badbit, вставки ничего не делают
+    return quietOutput ? muted : cout;
+}
+
+/** @brief Пул объектов одного типа: выделяет блоками, адреса стабильны, освобождает всё разом */
+template <typename T>
+class ObjectPool {
+    private:
+    mutable mutex guard; // создавать объекты могут сразу несколько потоков
+    vector<T*> blocks;
+    size_t perBlock;
+    size_t usedInLast = 0; // сколько занято в последнем блоке
+    size_t live = 0;
+
+    public:
+    explicit ObjectPool(size_t blockBytes = 1 << 16)
+        : perBlock(max<size_t>(1, blockBytes / sizeof(T))) {}
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator=(const ObjectPool&) = delete;
+
+    template <typename... Args>
+    T* create(Args&&... args) {
+        lock_guard<mutex> lock(guard);
+        if (blocks.empty() || usedInLast == perBlock) {
+            blocks.push_back(static_cast<T*>(::operator new(sizeof(T) * perBlock, align_val_t(alignof(T)))));
+            usedInLast = 0;
+        }
+        T* item = new (blocks.back() + usedInLast) T(std::forward<Args>(args)...);
+        ++usedInLast;
+        ++live;
+        return item;
+    }
+
+    //деструкторы всех объектов и возврат блоков целиком
+    void releaseAll() {
+        lock_guard<mutex> lock(guard);
+        for (size_t b = 0; b < blocks.size(); ++b) {
+            size_t used = (b + 1 == blocks.size()) ? usedInLast : perBlock;
+            for (size_t i = 0; i < used; ++i) {
+                blocks[b][i].~T();
+            }
+            ::operator delete(blocks[b], align_val_t(alignof(T)));
+        }
+        blocks.clear();
+        usedInLast = 0;
+        live = 0;
+    }
+
+    size_t size() const {
+        lock_guard<mutex> lock(guard);
+        return live;
+    }
+    size_t blockCount() const {
+        lock_guard<mutex> lock(guard);
+        return blocks.size();
+    }
+    size_t bytesReserved() const {
+        lock_guard<mutex> lock(guard);
+        return blocks.size() * perBlock * sizeof(T);
+    }
+
+    ~ObjectPool() {
+        releaseAll();
+    }
+};
+/** @brief Реестр сущностей по id */
+template <typename T>
+class IdRegistry {
+    private:
+    // id раздаются подряд с 1, поэтому хватает плотной таблицы id -> указатель.
+    // таблица из кусков фиксированного размера: кусок, раз появившись, не переезжает,
+    // так что читатели ходят без блокировок, пока вставка добавляет новые куски
+    static constexpr size_t CHUNK_BITS = 14;
+    static constexpr size_t CHUNK = size_t(1) << CHUNK_BITS;
+    static constexpr size_t MAX_CHUNKS = size_t(1) << 14; // до ~268 млн id
+
+    unique_ptr<atomic<atomic<T*>*>[]> chunks;
+    mutex growLock;
+
+    public:
+    IdRegistry() : chunks(new atomic<atomic<T*>*>[MAX_CHUNKS]) {
+        for (size_t c = 0; c < MAX_CHUNKS; ++c) chunks[c].store(nullptr, memory_order_relaxed);
+    }
+    IdRegistry(const IdRegistry&) = delete;
+    IdRegistry& operator=(const IdRegistry&) = delete;
+    ~IdRegistry() {
+        clear();
+    }
+
+    void put(int id, T* item) {
+        if (id <= 0) return;
+        size_t c = static_cast<size_t>(id) >> CHUNK_BITS;
+        if (c >= MAX_CHUNKS) return;
+        atomic<T*>* chunk = chunks[c].load(memory_order_acquire);
+        if (!chunk) {
+            lock_guard<mutex> lock(growLock);
+            chunk = chunks[c].load(memory_order_relaxed);
+            if (!chunk) {
+                chunk = new atomic<T*>[CHUNK];
+                for (size_t i = 0; i < CHUNK; ++i) chunk[i].store(nullptr, memory_order_relaxed);
+                chunks[c].store(chunk, memory_order_release);
+            }
+        }
+        chunk[static_cast<size_t>(id) & (CHUNK - 1)].store(item, memory_order_release);
+    }
+    //O(1) и без блокировок, для чужих и несуществующих id вернёт nullptr
+    T* get(int id) const {
+        if (id <= 0) return nullptr;
+        size_t c = static_cast<size_t>(id) >> CHUNK_BITS;
+        if (c >= MAX_CHUNKS) return nullptr;
+        atomic<T*>* chunk = chunks[c].load(memory_order_acquire);
+        if (!chunk) return nullptr;
+        return chunk[static_cast<size_t>(id) & (CHUNK - 1)].load(memory_order_acquire);
+    }
+    //очистка только при отсутствии читателей (загрузка снимка, выход)
+    void clear() {
+        for (size_t c = 0; c < MAX_CHUNKS; ++c) {
+            delete[] chunks[c].exchange(nullptr, memory_order_relaxed);
+        }
+    }
+};
+
+/** @brief Вход для операций и точка покоя для снимка
+ *
+ * Операция отмечается только в полосе своего потока, поэтому потоки не делят линию кеша,
+ * как делили бы счётчик читателей у shared_mutex. Снимок закрывает вход и ждёт, пока
+ * все полосы опустеют: после этого ни одна операция не идёт, пока он не откроет снова.
+ * Вход не вложенный: операция не должна звать другую операцию.
+ */
+class QuiesceGate {
+    private:
+    static constexpr size_t STRIPES = 64; //потоков больше - делят полосы, это только дороже, не ошибка
+
+    struct alignas(64) Stripe {
+        atomic<int> active{0};
+    };
+    Stripe stripes[STRIPES];
+    alignas(64) atomic<bool> closed{false};
+    mutex closer; //держит тот, кто закрыл; ждущие у входа спят на нём же
+
+    static Stripe& stripeOf(QuiesceGate& gate) {
+        static atomic<size_t> nextStripe{0};
+        thread_local size_t mine = nextStripe.fetch_add(1, memory_order_relaxed) % STRIPES;
+        return gate.stripes[mine];
+    }
+
+    public:
+    class Pass {
+        private:
+        Stripe* stripe;
+
+        public:
+        explicit Pass(Stripe* stripe_) : stripe(stripe_) {}
+        Pass(const Pass&) = delete;
+        Pass& operator=(const Pass&) = delete;
+        ~Pass() {
+            stripe->active.fetch_sub(1, memory_order_release);
+        }
+    };
+    class Quiet {
+        private:
+        QuiesceGate& gate;
+
+        public:
+        explicit Quiet(QuiesceGate& gate_) : gate(gate_) {}
+        Quiet(const Quiet&) = delete;
+        Quiet& operator=(const Quiet&) = delete;
+        ~Quiet() {
+            gate.closed.store(false, memory_order_release);
+            gate.closer.unlock();
+        }
+    };
+
+    //войти на время операции; если идёт снимок - дождаться его конца
+    Pass enter() {
+        Stripe& stripe = stripeOf(*this);
+        for (;;) {
+            // отметка и проверка seq_cst: либо снимок увидит отметку, либо мы увидим закрытый вход
+            stripe.active.fetch_add(1, memory_order_seq_cst);
+            if (!closed.load(memory_order_seq_cst)) return Pass(&stripe);
+            stripe.active.fetch_sub(1, memory_order_release);
+            lock_guard<mutex> wait(closer);
+        }
+    }
+    //закрыть вход и дождаться, пока начатые операции закончатся
+    Quiet quiesce() {
+        closer.lock();
+        closed.store(true, memory_order_seq_cst);
+        for (Stripe& stripe : stripes) {
+            while (stripe.active.load(memory_order_seq_cst) != 0) this_thread::yield();
+        }
+        return Quiet(*this);
+    }
+};
+
+/** @brief Ручка на строку из пула: 8 байт, равенство - сравнение указателей, текст читается без блокировок */
+class InternedString {
+    public:
+    // заголовок строки в пуле, символы лежат сразу за ним
+    struct Entry {
+        uint32_t length;
+        uint32_t id; // порядковый номер различной строки в пуле, 0 - пустая или не из индекса
+        const char* chars() const { return reinterpret_cast<const char*>(this + 1); }
+    };
+
+    private:
+    inline static const Entry EMPTY{0, 0};
+    const Entry* entry = &EMPTY;
+
+    public:
+    InternedString() = default;
+    explicit InternedString(const Entry* entry_) : entry(entry_) {}
+
+    string_view view() const { return string_view(entry->chars(), entry->length); }
+    operator string_view() const { return view(); }
+    string str() const { return string(view()); }
+    uint32_t id() const { return entry->id; }
+    bool empty() const { return entry->length == 0; }
+    bool operator==(const InternedString& other) const { return entry == other.entry; }
+    bool operator!=(const InternedString& other) const { return entry != other.entry; }
+};
+
+inline ostream& operator<<(ostream& out, const InternedString& s) {
+    return out << s.view();
+}
+
+/** @brief Пул строк: каждая различная строка хранится один раз в блоках, объекты держат ручки
+ *
+ * intern() ищет текст в индексе - для групп и названий, которые повторяются тысячами.
+ * keep() только кладёт текст в блок без индекса - для почти уникальных имён людей:
+ * там узел хеш-таблицы съел бы всю выгоду, а упаковка в блок всё равно дешевле std::string.
+ */
+class StringPool {
+    private:
+    using Entry = InternedString::Entry;
+    static constexpr size_t BLOCK = 64 * 1024;
+
+    mutable shared_mutex guard; // искать можно многим сразу, добавлять - по одному
+    unordered_map<string_view, const Entry*> index; // ключи смотрят в блоки, блоки не двигаются
+    vector<unique_ptr<char[]>> blocks;
+    char* cursor = nullptr;
+    size_t left = 0;
+    size_t reservedBytes = 0;
+    size_t storedBytes = 0;
+    size_t kept = 0; // строк от keep(), в индекс не попали
+
+    // для отчёта: сколько ручек раздали и во что обошлись бы отдельные std::string
+    atomic<size_t> handles{0};
+    atomic<size_t> plainBytes{0};
+
+    // память одной std::string: сам объект плюс куча glibc для длинных (заголовок 8 байт, шаг 16, минимум 32)
+    static size_t plainStringBytes(size_t len) {
+        size_t bytes = sizeof(string);
+        if (len > 15) bytes += max<size_t>(32, (len + 1 + 8 + 15) / 16 * 16);
+        return bytes;
+    }
+
+    // под исключительной блокировкой; indexed - добавить в индекс для intern()
+    const Entry* store(string_view text, bool indexed) {
+        size_t need = (sizeof(Entry) + text.size() + alignof(Entry) - 1) / alignof(Entry) * alignof(Entry);
+        if (need > left) {
+            size_t size = max(BLOCK, need);
+            blocks.emplace_back(new char[size]);
+            cursor = blocks.back().get();
+            left = size;
+            reservedBytes += size;
+        }
+        Entry* e = new (cursor) Entry{static_cast<uint32_t>(text.size()), indexed ? static_cast<uint32_t>(index.size() + 1) : 0};
+        memcpy(cursor + sizeof(Entry), text.data(), text.size());
+        cursor += need;
+        left -= need;
+        storedBytes += need;
+        if (indexed) index.emplace(string_view(e->chars(), text.size()), e);
+        else ++kept;
+        return e;
+    }
+
+    public:
+    StringPool() = default;
+    StringPool(const StringPool&) = delete;
+    StringPool& operator=(const StringPool&) = delete;
+
+    // ручка для хранения в объекте; одинаковый текст - одна и та же ручка
+    InternedString intern(string_view text) {
+        ++handles;
+        plainBytes += plainStringBytes(text.size());
+        if (text.empty()) return InternedString();
+        {
+            shared_lock<shared_mutex> lock(guard);
+            auto it = index.find(text);
+            if (it != index.end()) return InternedString(it->second);
+        }
+        unique_lock<shared_mutex> lock(guard);
+        auto it = index.find(text);
+        if (it != index.end()) return InternedString(it->second);
+        return InternedString(store(text, true));
+    }
+
+    // без поиска одинаковых: ручки от keep() равны только сами себе
+    InternedString keep(string_view text) {
+        ++handles;
+        plainBytes += plainStringBytes(text.size());
+        if (text.empty()) return InternedString();
+        unique_lock<shared_mutex> lock(guard);
+        return InternedString(store(text, false));
+    }
+
+    // только поиск, без добавления: строки нет в пуле - значит, ни один объект её не держит
+    bool find(string_view text, InternedString& out) const {
+        if (text.empty()) {
+            out = InternedString();
+            return true;
+        }
+        shared_lock<shared_mutex> lock(guard);
+        auto it = index.find(text);
+        if (it == index.end()) return false;
+        out = InternedString(it->second);
+        return true;
+    }
+
+    // вместе со всеми объектами, которые держат ручки
+    void clear() {
+        unique_lock<shared_mutex> lock(guard);
+        index.clear();
+        blocks.clear();
+        cursor = nullptr;
+        left = 0;
+        reservedBytes = storedBytes = kept = 0;
+        handles = 0;
+        plainBytes = 0;
+    }
+
+    void printReport() const {
+        shared_lock<shared_mutex> lock(guard);
+        size_t indexBytes = index.size() * 48 + index.bucket_count() * sizeof(void*); // узел ~48 байт с заголовком кучи
+        size_t handleBytes = handles * sizeof(InternedString);
+        size_t pooled = reservedBytes + indexBytes + handleBytes;
+        size_t plain = plainBytes;
+        cout << "пул строк: ручек " << handles << ", различных строк " << index.size()
+             << ", имён без индекса " << kept << ", блоков " << blocks.size() << "\n";
+        cout << "  в пуле: строки " << storedBytes / 1024 << " КБ (зарезервировано " << reservedBytes / 1024
+             << " КБ), индекс ~" << indexBytes / 1024 << " КБ, ручки " << handleBytes / 1024 << " КБ\n";
+        cout << "  отдельными std::string было бы ~" << plain / 1024 << " КБ, ";
+        if (plain >= pooled) {
+            cout << "экономия " << (plain - pooled) / 1024 << " КБ (" << (plain ? 100 * (plain - pooled) / plain : 0) << "%)\n";
+        } else {
+            cout << "перерасход " << (pooled - plain) / 1024 << " КБ\n";
+        }
+    }
+};
+
+const size_t SEARCH_LIMIT = 20; // сколько совпадений показывает поиск
+
+/** @brief Что нашёл поиск */
+enum class SearchKind : uint8_t {
+    Student,
+    Teacher,
+    Subject,
+    Work
+};
+
+/** @brief Поисковый индекс по именам, группам, названиям предметов и работ
+ *
+ * Текст сворачивается: нижний регистр латиницы и кириллицы, ё считается за е. Свёрнутый текст
+ * режется на триграммы кодовых точек, а у каждого слова есть ещё граммы начала - по ним ищутся
+ * префиксы из одной-двух букв. Номера документов только растут, поэтому списки вхождений,
+ * которые лишь дописываются, всегда отсортированы и пересекаются без сортировки.
+ * Кандидатов сверяем со свёрнутым текстом и останавливаемся, набрав лимит.
+ */
+class SearchIndex {
+    public:
+    struct Hit {
+        SearchKind kind;
+        int id;
+        int parent; // у работы - id предмета
+    };
+
+    private:
+    struct Doc {
+        SearchKind kind;
+        int id;
+        int parent;
+        uint32_t offset; // свёрнутый текст лежит в texts
+        uint32_t length;
+    };
+
+    mutable shared_mutex guard;
+    vector<Doc> docs;
+    string texts;
+    unordered_map<uint64_t, vector<uint32_t>> postings; // грамма -> номера документов по возрастанию
+    size_t entries = 0;
+
+    static constexpr uint32_t WORD_START = 0; // метка начала слова в граммах, в тексте нуля не бывает
+
+    static uint64_t gram(uint32_t a, uint32_t b, uint32_t c) {
+        return static_cast<uint64_t>(a) << 42 | static_cast<uint64_t>(b) << 21 | c;
+    }
+    // всё не-ASCII считаем буквами: так и кириллица, и байты внутри UTF-8 последовательности
+    static bool isWordChar(uint32_t cp) {
+        return cp >= 0x80 || (cp >= '0' && cp <= '9') || (cp >= 'a' && cp <= 'z');
+    }
+    static uint32_t foldCodepoint(uint32_t cp) {
+        if (cp >= 'A' && cp <= 'Z') return cp + 32;
+        if (cp >= 0x400 && cp <= 0x40F) cp += 0x50; // Ѐ..Џ, среди них Ё
+        else if (cp >= 0x410 && cp <= 0x42F) cp += 0x20; // А..Я
+        return cp == 0x451 ? 0x435 : cp; // ё -> е
+    }
+    static void encode(uint32_t cp, string& out) {
+        if (cp < 0x80) {
+            out += static_cast<char>(cp);
+        } else if (cp < 0x800) {
+            out += static_cast<char>(0xC0 | cp >> 6);
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        } else if (cp < 0x10000) {
+            out += static_cast<char>(0xE0 | cp >> 12);
+            out += static_cast<char>(0x80 | (cp >> 6 & 0x3F));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        } else {
+            out += static_cast<char>(0xF0 | cp >> 18);
+            out += static_cast<char>(0x80 | (cp >> 12 & 0x3F));
+            out += static_cast<char>(0x80 | (cp >> 6 & 0x3F));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        }
+    }
+    // дописать свёрнутый текст байтами (для сверки) и кодовыми точками (для грамм);
+    // битый UTF-8 берём побайтно, запрос сворачивается так же, поэтому всё равно совпадёт
+    static void fold(string_view in, string& bytes, vector<uint32_t>& cps) {
+        size_t i = 0;
+        while (i < in.size()) {
+            unsigned char lead = static_cast<unsigned char>(in[i]);
+            size_t len = lead < 0x80 ? 1 : (lead >> 5) == 6 ? 2 : (lead >> 4) == 14 ? 3 : (lead >> 3) == 30 ? 4 : 0;
+            uint32_t cp = len == 1 ? lead : len == 2 ? (lead & 0x1Fu) : len == 3 ? (lead & 0x0Fu) : (lead & 0x07u);
+            bool valid = len != 0 && i + len <= in.size();
+            for (size_t k = 1; valid && k < len; ++k) {
+                unsigned char next = static_cast<unsigned char>(in[i + k]);
+                valid = (next & 0xC0) == 0x80;
+                cp = cp << 6 | (next & 0x3Fu);
+            }
+            if (!valid) {
+                cp = lead;
+                len = 1;
+            }
+            cp = foldCodepoint(cp);
+            cps.push_back(cp);
+            encode(cp, bytes);
+            i += len;
+        }
+    }
+    template <typename Fn>
+    static void forEachGram(const vector<uint32_t>& cps, Fn&& fn) {
+        for (size_t i = 0; i < cps.size(); ++i) {
+            if (isWordChar(cps[i]) && (i == 0 || !isWordChar(cps[i - 1]))) {
+                fn(gram(WORD_START, WORD_START, cps[i]));
+                if (i + 1 < cps.size()) fn(gram(WORD_START, cps[i], cps[i + 1]));
+            }
+            if (i + 2 < cps.size()) fn(gram(cps[i], cps[i + 1], cps[i + 2]));
+        }
+    }
+    // запрос встречается в тексте документа (для префикса - с начала слова)
+    bool matches(const Doc& doc, string_view query, bool prefix) const {
+        string_view text(texts.data() + doc.offset, doc.length);
+        for (size_t pos = text.find(query); pos != string_view::npos; pos = text.find(query, pos + 1)) {
+            if (!prefix || pos == 0 || !isWordChar(static_cast<unsigned char>(text[pos - 1]))) return true;
+        }
+        return false;
+    }
+
+    public:
+    // части (имя и группа) склеиваются через пробел
+    void add(SearchKind kind, int id, int parent, initializer_list<string_view> parts) {
+        // буферы потока: при массовой загрузке add зовётся миллионы раз
+        static thread_local string folded;
+        static thread_local vector<uint32_t> cps;
+        folded.clear();
+        cps.clear();
+        for (string_view part : parts) {
+            if (!cps.empty()) {
+                folded += ' ';
+                cps.push_back(' ');
+            }
+            fold(part, folded, cps);
+        }
+
+        unique_lock<shared_mutex> lock(guard);
+        uint32_t doc = static_cast<uint32_t>(docs.size());
+        docs.push_back({kind, id, parent, static_cast<uint32_t>(texts.size()), static_cast<uint32_t>(folded.size())});
+        texts += folded;
+        forEachGram(cps, [&](uint64_t key) {
+            vector<uint32_t>& list = postings[key];
+            if (!list.empty() && list.back() == doc) return; // грамма повторилась в этом же тексте
+            list.push_back(doc);
+            ++entries;
+        });
+    }
+
+    // до limit совпадений в порядке добавления; запросы короче трёх букв ищутся по началу слов
+    void find(string_view query, bool prefix, size_t limit, vector<Hit>& out) const {
+        out.clear();
+        string q;
+        vector<uint32_t> cps;
+        fold(query, q, cps);
+        if (cps.empty() || limit == 0) return;
+        if (cps.size() < 3) prefix = true;
+        if (prefix && !isWordChar(cps[0])) {
+            if (cps.size() < 3) return; // ни слова, ни триграммы - искать не по чему
+            prefix = false;
+        }
+
+        vector<uint64_t> keys;
+        if (prefix) keys.push_back(cps.size() == 1 ? gram(WORD_START, WORD_START, cps[0]) : gram(WORD_START, cps[0], cps[1]));
+        for (size_t i = 0; i + 2 < cps.size(); ++i) keys.push_back(gram(cps[i], cps[i + 1], cps[i + 2]));
+        sort(keys.begin(), keys.end());
+        keys.erase(unique(keys.begin(), keys.end()), keys.end());
+
+        shared_lock<shared_mutex> lock(guard);
+        vector<const vector<uint32_t>*> lists;
+        for (uint64_t key : keys) {
+            auto it = postings.find(key);
+            if (it == postings.end()) return;
+            lists.push_back(&it->second);
+        }
+        sort(lists.begin(), lists.end(), [](auto* a, auto* b) { return a->size() < b->size(); });
+
+        // идём по самому короткому списку, в остальных ищем от прежней позиции: кандидаты растут
+        vector<size_t> cursor(lists.size(), 0);
+        for (uint32_t doc : *lists[0]) {
+            bool inAll = true;
+            for (size_t k = 1; k < lists.size() && inAll; ++k) {
+                const vector<uint32_t>& list = *lists[k];
+                cursor[k] = static_cast<size_t>(lower_bound(list.begin() + static_cast<ptrdiff_t>(cursor[k]), list.end(), doc) - list.begin());
+                if (cursor[k] == list.size()) return; // дальше общих документов нет
+                inAll = list[cursor[k]] == doc;
+            }
+            if (!inAll || !matches(docs[doc], q, prefix)) continue;
+            out.push_back({docs[doc].kind, docs[doc].id, docs[doc].parent});
+            if (out.size() >= limit) return;
+        }
+    }
+
+    void clear() {
+        unique_lock<shared_mutex> lock(guard);
+        docs.clear();
+        texts.clear();
+        postings.clear();
+        entries = 0;
+    }
+
+    void printReport() const {
+        shared_lock<shared_mutex> lock(guard);
+        size_t listBytes = 0;
+        for (const auto& entry : postings) listBytes += entry.second.capacity() * sizeof(uint32_t);
+        size_t mapBytes = postings.size() * 48 + postings.bucket_count() * sizeof(void*);
+        size_t total = docs.capacity() * sizeof(Doc) + texts.capacity() + listBytes + mapBytes;
+        cout << "поисковый индекс: документов " << docs.size() << ", грамм " << postings.size()
+             << ", вхождений " << entries << ", ~" << total / 1024 << " КБ\n";
+    }
+};
+
+//роли и типы работ как компактные теги: имена - статические константы, без аллокаций
+enum class UserRole {
+    Student,
+    Teacher
+};
+inline string_view userRoleName(UserRole role) {
+    switch (role) {
+    case UserRole::Student: return "студент";
+    case UserRole::Teacher: return "препод";
+    }
+    return "";
+}
+
 /** @brief Базовый класс пользователя */
 class User{
     protected:
     int id;
-    string name;
+    InternedString name; //текст живёт в пуле строк системы
 
     public:
     //конструктор юзера
-    User(int id_, const string& name_) : id(id_), name(name_){}
+    User(int id_, InternedString name_) : id(id_), name(name_){}
     //так как будут потомки юзаем виртуальный деструктор
     virtual ~User() = default;
 
     int getId() const{
         return id;
     }
-    const string& getName() const{
+    string_view getName() const{
         return name;
     }
     //роль пользователя студент или препод (виртуал так как у юзер нет роли а у налсдеников есть)
@@ -30,21 +940,83 @@ class User{
         cout << "id: " << id << ", имя: " << name;
     }
 };
+class Subject;
+
+/** @brief Ссылка на слот задания внутри предмета */
+struct WorkRef{
+    Subject* subject;
+    size_t slot; //позиция слота в assigments предмета
+};
+
 /** @brief Студент */
 class Student : public User{
     private:
-    string group;
+    InternedString group; //групп несколько сотен на тысячи студентов - текст один на всех
+    mutable mutex indexLock; //обратный индекс правят предметы из разных потоков
+    vector<Subject*> enrolledSubjects; //на какие предметы записан
+    struct Held{
+        WorkRef ref;
+        int count; //занятий минус освобождений
+    };
+    vector<Held> works; //обратный индекс: какие слоты занял
+
+    //отметить занятие (+1) или освобождение (-1) слота. Предмет зовёт это уже после CAS,
+    //и освобождение может прийти раньше занятия - сумма от порядка не зависит
+    void noteHold(Subject* subject, size_t slot, int delta){
+        lock_guard<mutex> lock(indexLock);
+        for(size_t i = 0; i < works.size(); ++i){
+            if(works[i].ref.subject == subject && works[i].ref.slot == slot){
+                works[i].count += delta;
+                if(works[i].count == 0){
+                    works[i] = works.back();
+                    works.pop_back();
+                }
+                return;
+            }
+        }
+        works.push_back({{subject, slot}, delta});
+    }
 
     public:
     //конструктор студента
-    Student(int id_, const string& name_ , const string& group_) : User(id_, name_), group(group_){}
+    Student(int id_, InternedString name_ , InternedString group_) : User(id_, name_), group(group_){}
     //переопределяем роль
     string getRole() const override {
-        return "студент";
+        return string(userRoleName(UserRole::Student));
+    }
+    string_view getGroup() const{
+        return group;
     }
-    const string& getGroup() const{
+    //для сравнения групп: ручки из одного пула равны, только если равен текст
+    InternedString groupHandle() const{
         return group;
     }
+    //копии, чтобы читать без блокировки, пока предметы меняют индекс
+    vector<Subject*> getEnrolledSubjects() const{
+        lock_guard<mutex> lock(indexLock);
+        return enrolledSubjects;
+    }
+    //занятые слоты; слово слота всё равно стоит сверить: его могли освободить после копии
+    vector<WorkRef> getWorks() const{
+        lock_guard<mutex> lock(indexLock);
+        vector<WorkRef> held;
+        held.reserve(works.size());
+        for(const Held& h : works){
+            if(h.count > 0) held.push_back(h.ref);
+        }
+        return held;
+    }
+    //обратный индекс ведёт сам Subject при записи и освобождении слотов
+    void noteEnrolled(Subject* subject){
+        lock_guard<mutex> lock(indexLock);
+        enrolledSubjects.push_back(subject);
+    }
+    void noteReserved(Subject* subject, size_t slot){
+        noteHold(subject, slot, 1);
+    }
+    void noteReleased(Subject* subject, size_t slot){
+        noteHold(subject, slot, -1);
+    }
     //переопределяем метод инфы
     void printInfo() const override{
         cout << "[студент] ";
@@ -56,10 +1028,10 @@ class Student : public User{
 /** @brief Преподаватель */
 class Teacher : public User{
     public:
-    Teacher(int id_, const string& name_) : User(id_, name_){}
+    Teacher(int id_, InternedString name_) : User(id_, name_){}
 
     string getRole() const override {
-        return "препод";
+        return string(userRoleName(UserRole::Teacher));
     }
     void printInfo() const override{
         cout << "[препод] ";
@@ -71,21 +1043,32 @@ enum class WorkType {
     Report, //доклад
     Lab
 };
+inline string_view workTypeName(WorkType type) {
+    switch (type) {
+    case WorkType::Report: return "доклад";
+    case WorkType::Lab: return "лаба";
+    }
+    return "";
+}
+//код типа для машинных форматов (csv/json)
+inline string_view workTypeCode(WorkType type) {
+    return type == WorkType::Report ? "report" : "lab";
+}
 /** @brief Работа */
 class Work{
     protected:
     int id;
-    string title; //название задания
+    InternedString title; //название задания, одинаковые названия на разных предметах делят текст
 
     public:
-    Work(int id_, const string& title_) : id(id_), title(title_){}
+    Work(int id_, InternedString title_) : id(id_), title(title_){}
 
     virtual ~Work() = default;
 
     int getId() const{
         return id;
     }
-    const string& getTitle() const{
+    string_view getTitle() const{
         return title;
     }
     //функции которые должны будут реализовать наследники
@@ -99,13 +1082,13 @@ class Work{
 /** @brief Доклад */
 class ReportWork : public Work{
     public:
-    ReportWork(int id_, const string& title_) : Work(id_, title_){}
+    ReportWork(int id_, InternedString title_) : Work(id_, title_){}
 
     WorkType getType() const override{
         return WorkType::Report;
     }
     string getTypeName() const override{
-        return "доклад";
+        return string(workTypeName(WorkType::Report));
     }
     //переопределим инфу
     void printInfo() const override{
@@ -116,13 +1099,13 @@ class ReportWork : public Work{
 /** @brief Лабораторная */
 class LabWork : public Work{
     public:
-    LabWork(int id_, const string& title_) : Work(id_, title_){}
+    LabWork(int id_, InternedString title_) : Work(id_, title_){}
 
     WorkType getType() const override{
         return WorkType::Lab;
     }
     string getTypeName() const override{
-        return "лаба";
+        return string(workTypeName(WorkType::Lab));
     }
     void printInfo() const override{
         cout << "[лаба] ";
@@ -130,37 +1113,92 @@ class LabWork : public Work{
     }
 };
 
+/** @brief Пулы под работы, ими владеет система, а не предмет */
+struct WorkPools {
+    ObjectPool<ReportWork> reports;
+    ObjectPool<LabWork> labs;
+};
+
 /** @brief Фабрика работ */
 class WorkFactory {
     public:
-    //создаем объект нужного типа 
-    static Work* createWork(WorkType type, int id, const string& title){
-        //если доклад
+    //создаем объект нужного типа; он живёт в пуле и отдельно не удаляется
+    static Work* createWork(WorkType type, int id, InternedString title, WorkPools& pools){
         if(type == WorkType::Report){
-            return new ReportWork(id, title);
+            return pools.reports.create(id, title);
         }
-        //лаба
         if(type == WorkType::Lab){
-            return new LabWork(id, title);
+            return pools.labs.create(id, title);
         }
         return nullptr;
     }
 };
 
-/** @brief Слот задания */
+//биты состояния слота
+const uint8_t SLOT_RESERVED = 1 << 0;
+const uint8_t SLOT_SUBMITTED = 1 << 1;
+const uint8_t SLOT_APPROVED = 1 << 2;
+const uint8_t SLOT_LAB = 1 << 3; //тип работы: 0 - доклад, 1 - лаба
+
+//оценка хранится в 8 битах слова состояния: остальное отдано версии
+const int GRADE_MIN = numeric_limits<int8_t>::min();
+const int GRADE_MAX = numeric_limits<int8_t>::max();
+
+//состояние слота одним 64-битным словом, меняется целиком через CAS:
+//биты 0-3 - SLOT_*, 4-31 - id студента (0 - свободно), 32-39 - оценка, 40-63 - версия
+namespace slotword {
+
+const uint32_t VERSION_MASK = (1u << 24) - 1;
+
+inline uint8_t status(uint64_t w) {
+    return static_cast<uint8_t>(w & 0xF);
+}
+inline int reserver(uint64_t w) {
+    return static_cast<int>((w >> 4) & 0xFFFFFFF);
+}
+inline int grade(uint64_t w) {
+    return static_cast<int8_t>(static_cast<uint8_t>(w >> 32));
+}
+inline uint32_t version(uint64_t w) {
+    return static_cast<uint32_t>(w >> 40);
+}
+inline uint64_t make(uint8_t status, int reserver, int grade, uint32_t version) {
+    return (static_cast<uint64_t>(status) & 0xF) | (static_cast<uint64_t>(reserver & 0xFFFFFFF) << 4) |
+           (static_cast<uint64_t>(static_cast<uint8_t>(grade)) << 32) | (static_cast<uint64_t>(version & VERSION_MASK) << 40);
+}
+//каждый переход поднимает версию: по ней журнал восстанавливает порядок и CAS не путает похожие состояния
+inline uint64_t next(uint64_t old, uint8_t status, int reserver, int grade) {
+    return make(status, reserver, grade, version(old) + 1);
+}
+//новее ли a, чем b. Версии идут по кругу, сравнение верно, пока записи одного слота
+//разошлись в журнале меньше чем на 2^23 переходов (у 16-битной версии было всего 2^15)
+inline bool newer(uint64_t a, uint64_t b) {
+    uint32_t ahead = (version(a) - version(b)) & VERSION_MASK;
+    return ahead != 0 && ahead < (VERSION_MASK + 1) / 2;
+}
+//слово из журнала первой версии: оценка в 16 битах с 32-го, версия в 16 битах с 48-го
+inline uint64_t fromV1(uint64_t w) {
+    int oldGrade = static_cast<int16_t>(static_cast<uint16_t>(w >> 32));
+    return make(status(w), reserver(w), min(max(oldGrade, GRADE_MIN), GRADE_MAX), static_cast<uint16_t>(w >> 48));
+}
+
+} // namespace slotword
+
+/** @brief Слот задания (представление одного слота, сами данные в Subject лежат столбцами) */
 struct AssignmentSlot{
     Work* work;
+    WorkType type; //тип хранится прямо в слоте, чтобы не ходить в vtable при выводе
     Student* reservedBy; //студент который записался
     bool submitted; //студент сказл, что сдал
     bool approved; //препод подтвердил
     int grade; //оценка
 
-    AssignmentSlot(Work* w) : work(w), reservedBy(nullptr), submitted(false), approved(false), grade(0){}
+    AssignmentSlot(Work* w, WorkType t) : work(w), type(t), reservedBy(nullptr), submitted(false), approved(false), grade(0){}
 
     void print() const {
         if (work) {
             cout << "    задание #" << work->getId()
-                 << " (" << work->getTypeName() << "): "
+                 << " (" << workTypeName(type) << "): "
                  << work->getTitle() << "\n";
         } else {
             cout << "    (пустой слот без работы)\n";
@@ -187,52 +1225,402 @@ struct AssignmentSlot{
     }
 };
 
+// отладка: -DUNI_VERIFY_COUNTERS=1 сверяет счётчики с полным обходом после каждой команды
+#ifndef UNI_VERIFY_COUNTERS
+#define UNI_VERIFY_COUNTERS 0
+#endif
+
+/** @brief Сводка по статусам слотов без гистограммы - то, что отдают счётчики */
+struct SlotSummary {
+    long long freeSlots = 0;
+    long long reserved = 0;
+    long long submitted = 0;
+    long long approved = 0; //оно же число оценок
+    long long gradeSum = 0;
+
+    long long total() const {
+        return freeSlots + reserved + submitted + approved;
+    }
+    double mean() const {
+        return approved ? static_cast<double>(gradeSum) / approved : 0.0;
+    }
+    bool operator==(const SlotSummary& o) const {
+        return freeSlots == o.freeSlots && reserved == o.reserved && submitted == o.submitted &&
+               approved == o.approved && gradeSum == o.gradeSum;
+    }
+    bool operator!=(const SlotSummary& o) const {
+        return !(*this == o);
+    }
+};
+
+/** @brief Счётчики слотов по статусам
+ *
+ * Правятся после каждого перехода слова: вклад старого слова снимается, нового - добавляется.
+ * Статус определяется так же, как в ядрах статистики. Отдельные поля читаются без блокировки,
+ * поэтому сводка между операциями - "примерно сейчас", точная - когда операций нет.
+ */
+struct alignas(64) SlotCounters {
+    atomic<long long> freeSlots{0};
+    atomic<long long> reserved{0};
+    atomic<long long> submitted{0};
+    atomic<long long> approved{0};
+    atomic<long long> gradeSum{0};
+
+    void add(uint64_t w, long long sign) {
+        uint8_t st = slotword::status(w) & (SLOT_RESERVED | SLOT_SUBMITTED | SLOT_APPROVED);
+        if (st == 0) {
+            freeSlots.fetch_add(sign, memory_order_relaxed);
+        } else if (st == SLOT_RESERVED) {
+            reserved.fetch_add(sign, memory_order_relaxed);
+        } else if (st == (SLOT_RESERVED | SLOT_SUBMITTED)) {
+            submitted.fetch_add(sign, memory_order_relaxed);
+        } else if (st == (SLOT_RESERVED | SLOT_SUBMITTED | SLOT_APPROVED)) {
+            approved.fetch_add(sign, memory_order_relaxed);
+            gradeSum.fetch_add(sign * slotword::grade(w), memory_order_relaxed);
+        }
+    }
+    void move(uint64_t from, uint64_t to) {
+        add(from, -1);
+        add(to, 1);
+    }
+    SlotSummary load() const {
+        SlotSummary s;
+        s.freeSlots = freeSlots.load(memory_order_relaxed);
+        s.reserved = reserved.load(memory_order_relaxed);
+        s.submitted = submitted.load(memory_order_relaxed);
+        s.approved = approved.load(memory_order_relaxed);
+        s.gradeSum = gradeSum.load(memory_order_relaxed);
+        return s;
+    }
+    void reset() {
+        freeSlots = reserved = submitted = approved = gradeSum = 0;
+    }
+};
 
-/** @brief Предмет */
+/** @brief Предмет
+ *
+ * Переходы слотов (запись, сдача, оценка, отказ) идут через CAS по слову состояния и
+ * блокировок не берут: столбцы слотов не переезжают, а слот по id работы ищется без блокировки.
+ * addWork и запись студентов меняют столбцы и списки - эти под writeLock().
+ */
 class Subject {
     private:
     int id;
-    string name;
+    InternedString name;
     Teacher* owner; //указатель на препода, который ведёт предмет
+    WorkPools& workPools; //отсюда берутся работы, освобождает их система
+    const IdRegistry<Student>& studentIndex; //в слоте лежит id студента, указатель берём отсюда
+    mutable shared_mutex guard;
 
-    vector<Student*> students;
-    vector<AssignmentSlot> assigments;
+    vector<Student*> students; //в порядке записи, для printFull
+    //кто записан: хеш-множество id или, если id лежат плотно, битсет по их диапазону - проверка O(1) в обоих;
+    //битсет на все id университета у каждого предмета стоил бы O(предметов * студентов) памяти
+    static constexpr size_t DENSE_MIN_ENROLLED = 64; //меньше - битсет не заводим
+    static constexpr size_t DENSE_BITS_PER_ID = 64;  //битсет не больше хеш-множества (от 8 байт на студента)
+    vector<int> enrolledSet;   //открытая адресация, 0 - пустая ячейка (id студентов с 1); пока битсета нет
+    vector<bool> enrolledMask; //бит (id - enrolledBase)
+    size_t enrolledBase = 0;   //самый малый id, который покрывает битсет
+    int enrolledMin = numeric_limits<int>::max(); //диапазон id записанных
+    int enrolledMax = 0;
 
-    public:
-    Subject (int id_, const string& name_, Teacher* owner_) : id(id_), name(name_), owner(owner_){}
+    // слоты заданий хранятся столбцами: горячее слово состояния отдельно, чтобы сканы шли подряд по памяти.
+    // столбцы нарезаны кусками, каждый следующий вдвое больше прежнего: кусок, раз появившись, не переезжает
+    static constexpr size_t FIRST_CHUNK_BITS = 6; //первый кусок на 64 слота: обычный предмет сканируется одним куском
+    static constexpr size_t SLOT_CHUNKS = 17;     //до ~8 млн слотов на предмет
+    unique_ptr<uint64_t[]> stateChunks[SLOT_CHUNKS]; //слово slotword, читается и меняется только атомарно
+    unique_ptr<Work*[]> workChunks[SLOT_CHUNKS];     //холодные данные: название и т.п. нужны только при выводе
+    atomic<size_t> slotsUsed{0};                     //слоты до этого номера готовы к чтению
 
-    int getId() const{
-        return id;
+    // id работы -> номер слота: открытая адресация, ячейка (id << 32) | (номер + 1), 0 - пустая.
+    // ячейки только добавляются; выросшая таблица копируется в новую вдвое больше, а прежние живут
+    // до конца предмета - читатель мог взять указатель до замены, а вместе они меньше текущей
+    struct SlotTable {
+        size_t mask;
+        unique_ptr<atomic<uint64_t>[]> cells;
+    };
+    vector<unique_ptr<SlotTable>> slotTables; //последняя - текущая, правятся под writeLock
+    atomic<const SlotTable*> slotTable{nullptr};
+
+    SlotCounters counters; //статусы слотов этого предмета
+    SlotCounters& rollup;  //полоса общеуниверситетской сводки, её делят несколько предметов
+    atomic<uint64_t> version{0}; //растёт при любом изменении, что видно в отчёте
+
+    void touch() {
+        version.fetch_add(1, memory_order_release);
     }
-    const string& getName() const{
-        return name;
+
+    //окупается ли битсет на диапазоне id записанных
+    bool denseEnough() const {
+        return students.size() >= DENSE_MIN_ENROLLED &&
+               static_cast<size_t>(enrolledMax - enrolledMin) < DENSE_BITS_PER_ID * students.size();
     }
-    Teacher* getOwner() const{
-        return owner;
+
+    static size_t hashSlot(int key, size_t mask) {
+        return (static_cast<uint32_t>(key) * 2654435761u) & mask;
+    }
+    bool setContains(int studentId) const {
+        if (enrolledSet.empty()) return false;
+        size_t mask = enrolledSet.size() - 1;
+        for (size_t i = hashSlot(studentId, mask);; i = (i + 1) & mask) {
+            if (enrolledSet[i] == studentId) return true;
+            if (enrolledSet[i] == 0) return false;
+        }
+    }
+    void setInsert(int studentId) {
+        size_t mask = enrolledSet.size() - 1;
+        size_t i = hashSlot(studentId, mask);
+        while (enrolledSet[i] != 0) i = (i + 1) & mask;
+        enrolledSet[i] = studentId;
+    }
+    //таблица под всех из students, заполнена не больше чем наполовину
+    void rebuildSet() {
+        size_t capacity = 16;
+        while (capacity < 2 * students.size()) capacity *= 2;
+        enrolledSet.assign(capacity, 0);
+        for (Student* st : students) setInsert(st->getId());
+    }
+
+    //перейти на битсет по диапазону id всех из students
+    void toDense() {
+        enrolledBase = static_cast<size_t>(enrolledMin);
+        enrolledMask.assign(static_cast<size_t>(enrolledMax - enrolledMin) + 1, false);
+        for (Student* st : students) enrolledMask[static_cast<size_t>(st->getId()) - enrolledBase] = true;
+        vector<int>().swap(enrolledSet);
+    }
+
+    //id разбежались и битсет стал слишком редким - возвращаемся к хеш-множеству
+    void toSparse() {
+        vector<bool>().swap(enrolledMask);
+        rebuildSet();
+    }
+
+    //отметить id как записанный (сам студент уже лежит в students)
+    void markEnrolled(int studentId) {
+        enrolledMin = min(enrolledMin, studentId);
+        enrolledMax = max(enrolledMax, studentId);
+        if (enrolledMask.empty()) {
+            if (denseEnough()) toDense();
+            else if (enrolledSet.size() < 2 * students.size()) rebuildSet(); // уже с новым id
+            else setInsert(studentId);
+            return;
+        }
+        if (!denseEnough()) {
+            toSparse();
+            return;
+        }
+        size_t sid = static_cast<size_t>(studentId);
+        if (sid < enrolledBase) {
+            enrolledMask.insert(enrolledMask.begin(), enrolledBase - sid, false);
+            enrolledBase = sid;
+        }
+        if (sid - enrolledBase >= enrolledMask.size()) {
+            enrolledMask.resize(sid - enrolledBase + 1, false);
+        }
+        enrolledMask[sid - enrolledBase] = true;
+    }
+
+    //добавить в список и отметить id (без проверок и вывода)
+    void enroll(Student* student) {
+        students.push_back(student);
+        markEnrolled(student->getId());
+        student->noteEnrolled(this);
+        touch();
+    }
+
+    //найти слот по id работы за O(1) без блокировок, NO_SLOT если такой работы на предмете нет
+    static constexpr size_t NO_SLOT = static_cast<size_t>(-1);
+    size_t findSlot(int workId) const {
+        const SlotTable* table = slotTable.load(memory_order_acquire);
+        if (!table) return NO_SLOT;
+        size_t probes = 1;
+        for (size_t i = hashSlot(workId, table->mask);; i = (i + 1) & table->mask, ++probes) {
+            uint64_t cell = table->cells[i].load(memory_order_acquire);
+            if (cell == 0) break;
+            if (static_cast<int>(cell >> 32) == workId) {
+                METRIC_PROBES(SlotLookup, probes);
+                return static_cast<size_t>(cell & 0xFFFFFFFF) - 1;
+            }
+        }
+        METRIC_PROBES(SlotLookup, probes);
+        return NO_SLOT;
+    }
+    static void putCell(const SlotTable& table, uint64_t cell) {
+        size_t i = hashSlot(static_cast<int>(cell >> 32), table.mask);
+        while (table.cells[i].load(memory_order_relaxed) != 0) i = (i + 1) & table.mask;
+        table.cells[i].store(cell, memory_order_release);
+    }
+    //запомнить номер слота работы (под writeLock); таблица заполнена не больше чем наполовину
+    void indexSlot(int workId, size_t slot) {
+        uint64_t cell = (static_cast<uint64_t>(static_cast<uint32_t>(workId)) << 32) | (slot + 1);
+        const SlotTable* cur = slotTable.load(memory_order_relaxed);
+        if (cur && 2 * (slot + 1) <= cur->mask + 1) {
+            putCell(*cur, cell);
+            return;
+        }
+        size_t capacity = cur ? 2 * (cur->mask + 1) : 16;
+        auto grown = make_unique<SlotTable>();
+        grown->mask = capacity - 1;
+        grown->cells.reset(new atomic<uint64_t>[capacity]);
+        for (size_t i = 0; i < capacity; ++i) grown->cells[i].store(0, memory_order_relaxed);
+        if (cur) {
+            for (size_t i = 0; i <= cur->mask; ++i) {
+                uint64_t old = cur->cells[i].load(memory_order_relaxed);
+                if (old != 0) putCell(*grown, old);
+            }
+        }
+        putCell(*grown, cell);
+        slotTable.store(grown.get(), memory_order_release);
+        slotTables.push_back(move(grown));
+    }
+
+    //номер слота -> кусок столбца и место в нём
+    static size_t chunkOf(size_t i, size_t& offset) {
+        size_t j = i + (size_t(1) << FIRST_CHUNK_BITS);
+        size_t top = 63 - static_cast<size_t>(__builtin_clzll(j));
+        offset = j - (size_t(1) << top);
+        return top - FIRST_CHUNK_BITS;
+    }
+    uint64_t* stateCell(size_t i) const {
+        size_t offset = 0;
+        size_t c = chunkOf(i, offset);
+        return &stateChunks[c][offset];
+    }
+    Work* workAt(size_t i) const {
+        size_t offset = 0;
+        size_t c = chunkOf(i, offset);
+        return workChunks[c][offset];
+    }
+
+    uint64_t loadState(size_t i) const {
+        return __atomic_load_n(stateCell(i), __ATOMIC_ACQUIRE);
+    }
+    //при неудаче expected получает текущее слово; при успехе переход учитывается в счётчиках
+    bool casState(size_t i, uint64_t& expected, uint64_t desired) {
+        if (!__atomic_compare_exchange_n(stateCell(i), &expected, desired, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            return false;
+        }
+        countMove(expected, desired);
+        return true;
+    }
+    void countMove(uint64_t from, uint64_t to) {
+        counters.move(from, to);
+        rollup.move(from, to);
+        touch();
+    }
+
+    //освободить слот; expectStudent = 0 - кто бы его ни держал. false если держатель не тот
+    //обратный индекс правим уже после CAS: Student сводит занятия и освобождения в любом порядке
+    bool releaseSlot(size_t i, int expectStudent, uint64_t& next) {
+        uint64_t cur = loadState(i);
+        int holder = 0;
+        do {
+            holder = slotword::reserver(cur);
+            if (holder == 0 || (expectStudent != 0 && holder != expectStudent)) return false;
+            next = slotword::next(cur, slotword::status(cur) & SLOT_LAB, 0, 0);
+        } while (!casState(i, cur, next));
+        if (Student* st = studentIndex.get(holder)) st->noteReleased(this, i);
+        return true;
+    }
+
+    //поставить слово как есть вместе с обратным индексом (снимок и журнал, без конкурентов)
+    bool setState(size_t i, uint64_t word) {
+        uint64_t cur = loadState(i);
+        Student* next = slotword::reserver(word) ? studentIndex.get(slotword::reserver(word)) : nullptr;
+        if (slotword::reserver(word) && !next) return false;
+        if (Student* prev = slotword::reserver(cur) ? studentIndex.get(slotword::reserver(cur)) : nullptr) {
+            prev->noteReleased(this, i);
+        }
+        //тип работы задаётся слотом, а не записью
+        word = (word & ~static_cast<uint64_t>(SLOT_LAB)) | (slotword::status(cur) & SLOT_LAB);
+        __atomic_store_n(stateCell(i), word, __ATOMIC_RELEASE);
+        countMove(cur, word);
+        if (next) next->noteReserved(this, i);
+        return true;
+    }
+
+    public:
+    Subject (int id_, InternedString name_, Teacher* owner_, WorkPools& pools_, const IdRegistry<Student>& studentIndex_,
+             SlotCounters& rollup_)
+        : id(id_), name(name_), owner(owner_), workPools(pools_), studentIndex(studentIndex_), rollup(rollup_){}
+
+    int getId() const{
+        return id;
+    }
+    string_view getName() const{
+        return name;
+    }
+    Teacher* getOwner() const{
+        return owner;
+    }
+    //блокировка предмета: writeLock - добавлять слоты и менять списки, readLock - читать списки
+    unique_lock<shared_mutex> writeLock() const {
+        return unique_lock<shared_mutex>(guard);
+    }
+    shared_lock<shared_mutex> readLock() const {
+        return shared_lock<shared_mutex>(guard);
+    }
+    //записан ли студент на предмет
+    bool isEnrolled(const Student* student) const {
+        if (!student) return false;
+        if (enrolledMask.empty()) return setContains(student->getId());
+        size_t sid = static_cast<size_t>(student->getId());
+        return sid >= enrolledBase && sid - enrolledBase < enrolledMask.size() && enrolledMask[sid - enrolledBase];
     }
     //инвайт студента на предмет
-    void addStudent(Student* student) {
+    bool addStudent(Student* student) {
         if (!student) {
             cout << "ошибка: нет студента\n";
-            return;
+            return false;
         }
     
         // Проверка на дубликаты
-        for (auto* s : students) {
-            if (s == student) {
-                cout << "студент уже записан на предмет\n";
-                return;
-            }
+        if (isEnrolled(student)) {
+            cout << "студент уже записан на предмет\n";
+            return false;
         }
     
-        students.push_back(student);
-        cout << "студент добавлен на предмет\n";
+        enroll(student);
+        chatter() << "студент добавлен на предмет\n";
+        return true;
+    }
+    //записать сразу пачку студентов (например всю группу), возвращает сколько реально добавилось
+    size_t addStudents(const vector<Student*>& group) {
+        students.reserve(students.size() + group.size());
+
+        size_t added = 0;
+        for (Student* st : group) {
+            if (!st || isEnrolled(st)) continue;
+            enroll(st);
+            ++added;
+        }
+        return added;
     }
     
     //добавить задание
-    void addWork(WorkType type, int id, const string& title){
-        Work* w = WorkFactory::createWork(type, id, title); //связь с фабрикой
-        assigments.emplace_back(w); // создаём слот для этой работы
+    void addWork(WorkType type, int workId, InternedString title){
+        Work* w = WorkFactory::createWork(type, workId, title, workPools); //связь с фабрикой
+        if (!w) return;
+        // создаём слот для этой работы: сначала заполняем, потом он становится виден по id и в slotCount
+        size_t i = slotsUsed.load(memory_order_relaxed);
+        size_t offset = 0;
+        size_t c = chunkOf(i, offset);
+        if (c >= SLOT_CHUNKS) {
+            cout << "ошибка: на предмете слишком много заданий\n";
+            return;
+        }
+        if (!stateChunks[c]) {
+            size_t size = size_t(1) << (c + FIRST_CHUNK_BITS);
+            stateChunks[c].reset(new uint64_t[size]);
+            workChunks[c].reset(new Work*[size]);
+        }
+        uint64_t word = slotword::make(type == WorkType::Lab ? SLOT_LAB : 0, 0, 0, 0);
+        __atomic_store_n(&stateChunks[c][offset], word, __ATOMIC_RELAXED);
+        workChunks[c][offset] = w;
+        indexSlot(workId, i);
+        slotsUsed.store(i + 1, memory_order_release);
+        counters.add(word, 1);
+        rollup.add(word, 1);
+        touch();
     }
     //краткий вывод
     void printShort() const{
@@ -241,7 +1629,7 @@ class Subject {
         if(owner){
             cout << ", препод: " << owner -> getName();
         }
-        cout << endl;
+        cout << "\n";
     }
     //вывод полной инфы
     void printFull() const {
@@ -251,16 +1639,18 @@ class Subject {
         for (Student* st : students) {
             cout << "    - ";
             if (st) {
-                st->printInfo();
+                // то же, что Student::printInfo, но без виртуального вызова
+                cout << "[" << userRoleName(UserRole::Student) << "] id: " << st->getId()
+                     << ", имя: " << st->getName() << ", группа " << st->getGroup();
             } else {
                 cout << "(null студент)";
             }
             cout << "\n";
         }
     
-        cout << "  задания (" << assigments.size() << "):\n";
-        for (const AssignmentSlot& slot : assigments) {
-            slot.print(); // у слота свой красивый вывод
+        cout << "  задания (" << slotCount() << "):\n";
+        for (size_t i = 0; i < slotCount(); ++i) {
+            slotAt(i).print(); // у слота свой красивый вывод
         }
     }
 
@@ -269,612 +1659,4415 @@ class Subject {
         return students;
     }
 
-    const vector<AssignmentSlot>& getAssignmentsList() const {
-        return assigments;
+    size_t slotCount() const {
+        return slotsUsed.load(memory_order_acquire);
+    }
+    //собрать слот целиком: слово состояния читается один раз, поэтому вид согласованный
+    AssignmentSlot slotAt(size_t i) const {
+        uint64_t w = loadState(i);
+        AssignmentSlot slot(workAt(i), (slotword::status(w) & SLOT_LAB) ? WorkType::Lab : WorkType::Report);
+        slot.reservedBy = slotword::reserver(w) ? studentIndex.get(slotword::reserver(w)) : nullptr;
+        slot.submitted = slotword::status(w) & SLOT_SUBMITTED;
+        slot.approved = slotword::status(w) & SLOT_APPROVED;
+        slot.grade = slotword::grade(w);
+        return slot;
+    }
+    //старое представление списком слотов (собирается на лету, для горячих путей есть slotAt и столбцы)
+    vector<AssignmentSlot> getAssignmentsList() const {
+        vector<AssignmentSlot> list;
+        list.reserve(slotCount());
+        for (size_t i = 0; i < slotCount(); ++i) {
+            list.push_back(slotAt(i));
+        }
+        return list;
+    }
+    // сырой столбец слов для агрегатных сканов: f(слова, сколько) на каждый кусок подряд
+    template <typename F>
+    void forEachStateRun(F&& f) const {
+        size_t n = slotCount();
+        for (size_t c = 0, start = 0; start < n; ++c) {
+            size_t size = size_t(1) << (c + FIRST_CHUNK_BITS);
+            f(static_cast<const uint64_t*>(stateChunks[c].get()), min(size, n - start));
+            start += size;
+        }
+    }
+    uint64_t slotStateAt(size_t i) const {
+        return loadState(i);
+    }
+    //сводка по статусам за O(1), без обхода слотов
+    SlotSummary summary() const {
+        return counters.load();
+    }
+    //работа по id, nullptr если на предмете такой нет
+    const Work* findWork(int workId) const {
+        size_t i = findSlot(workId);
+        return i == NO_SLOT ? nullptr : workAt(i);
+    }
+    //версия изменений: совпала с прежней - отчёт по предмету тот же
+    uint64_t getVersion() const {
+        return version.load(memory_order_acquire);
     }
 
-    //студент записался на задание по айди
-    bool reserveWork(int workId, Student* student){
-        for(auto& slot : assigments){
-            if(slot.work && slot.work -> getId() == workId){
-                if(slot.reservedBy != nullptr){
-                    cout << "Слот уже занят другим студентом" << endl;
-                    return false;
-                }
-                slot.reservedBy = student;
-                slot.submitted = false;
-                slot.approved = false;
-                slot.grade = 0;
-                cout << "студент " << student -> getName() << " записаля на задание #" << workId << endl;
-                return true;
+    //студент записался на задание по айди; в newState - слово после перехода (для журнала)
+    bool reserveWork(int workId, Student* student, uint64_t* newState = nullptr){
+        size_t i = findSlot(workId);
+        if(i == NO_SLOT){
+            cout << "задание с id " << workId << " не найдено в этом предмете" << "\n";
+            return false;
+        }
+        uint64_t cur = loadState(i), next = 0;
+        bool won = false;
+        while (slotword::reserver(cur) == 0) {
+            next = slotword::next(cur, (slotword::status(cur) & SLOT_LAB) | SLOT_RESERVED, student->getId(), 0);
+            if (casState(i, cur, next)) {
+                won = true;
+                break;
             }
         }
-        cout << "задание с id " << workId << " не найдено в этом предмете" << endl;
-        return false;
+        if(!won){
+            cout << "Слот уже занят другим студентом" << "\n";
+            return false;
+        }
+        student->noteReserved(this, i); //после CAS: если слот уже успели освободить, Student сведёт счёт
+
+        if (newState) *newState = next;
+        chatter() << "студент " << student -> getName() << " записаля на задание #" << workId << "\n";
+        return true;
     }
     //студент отмечает, что сдал
-    bool markSubmitted(int workId, Student* student){
-        for(auto& slot : assigments){
-            if(slot.work && slot.work -> getId() == workId){
-                if(slot.reservedBy != student){
-                    cout <<"это задание не занятом этим студентом" << endl;
-                    return false;
-                }
-                slot.submitted = true;
-                cout << "студент " << student -> getName() << " отметил, что сдал задание #" << workId << endl;
-                return true;
-            }
+    bool markSubmitted(int workId, Student* student, uint64_t* newState = nullptr){
+        size_t i = findSlot(workId);
+        if(i == NO_SLOT){
+            cout << "задание с id " << workId << " не найдено" << "\n";
+            return false;
         }
-        cout << "задание с id " << workId << " не найдено" << endl;
-        return false;
+        uint64_t cur = loadState(i), next = 0;
+        do {
+            if(slotword::reserver(cur) != student -> getId()){
+                cout <<"это задание не занятом этим студентом" << "\n";
+                return false;
+            }
+            next = slotword::next(cur, slotword::status(cur) | SLOT_SUBMITTED, slotword::reserver(cur), slotword::grade(cur));
+        } while (!casState(i, cur, next));
+        if (newState) *newState = next;
+        chatter() << "студент " << student -> getName() << " отметил, что сдал задание #" << workId << "\n";
+        return true;
     }
     //препод утверждает сдачу и ставит оценку
-    bool approveWork(int workId, int grade) {
-        for (auto& slot : assigments){
-            if(slot.work && slot.work -> getId() == workId){
-                if(slot.reservedBy == nullptr){
-                    cout << "на данное задание никто не записан" << endl;
-                    return false;
-                }
-                if(!slot.submitted){
-                    cout << "студент ещё не отметил сдачу" << endl;
-                    return false;
-                }
-                slot.approved = true;
-                slot.grade = grade;
-                cout << "сдача задания #" << workId << " утверждена, оценка: " << grade << endl;
-                return true;
+    bool approveWork(int workId, int grade, uint64_t* newState = nullptr) {
+        size_t i = findSlot(workId);
+        if(i == NO_SLOT){
+            cout << "задание с id " << workId << " не найдено" << "\n";
+            return false;
+        }
+        if(grade < GRADE_MIN || grade > GRADE_MAX){
+            cout << "оценка должна быть от " << GRADE_MIN << " до " << GRADE_MAX << "\n";
+            return false;
+        }
+        uint64_t cur = loadState(i), next = 0;
+        do {
+            if(slotword::reserver(cur) == 0){
+                cout << "на данное задание никто не записан" << "\n";
+                return false;
             }
-        } 
-        cout << "задание с id " << workId << " не найдено" << endl;
-        return false;
+            if(!(slotword::status(cur) & SLOT_SUBMITTED)){
+                cout << "студент ещё не отметил сдачу" << "\n";
+                return false;
+            }
+            next = slotword::next(cur, slotword::status(cur) | SLOT_APPROVED, slotword::reserver(cur), grade);
+        } while (!casState(i, cur, next));
+        if (newState) *newState = next;
+        chatter() << "сдача задания #" << workId << " утверждена, оценка: " << grade << "\n";
+        return true;
     }
       // преподаватель отклоняет сдачу, слот очищается
-      bool rejectWork(int workId) {
-        for (auto& slot : assigments) {
-            if (slot.work && slot.work->getId() == workId) {
-                if (slot.reservedBy == nullptr) {
-                    cout << "на это задание никто не записан\n";
-                    return false;
-                }
-                cout << "сдача задания #" << workId << " отклонена, слот освобождён\n";
-                slot.reservedBy = nullptr;
-                slot.submitted = false;
-                slot.approved = false;
-                slot.grade = 0;
-                return true;
-            }
+      bool rejectWork(int workId, uint64_t* newState = nullptr) {
+        size_t i = findSlot(workId);
+        if (i == NO_SLOT) {
+            cout << "задание с id " << workId << " не найдено\n";
+            return false;
         }
-        cout << "задание с id " << workId << " не найдено\n";
-        return false;
+        uint64_t next = 0;
+        if (!releaseSlot(i, 0, next)) {
+            cout << "на это задание никто не записан\n";
+            return false;
+        }
+        if (newState) *newState = next;
+        chatter() << "сдача задания #" << workId << " отклонена, слот освобождён\n";
+        return true;
     }
 
     // студент сам спрыгивает с задания
-    bool dropWork(int workId, Student* student) {
-        for (auto& slot : assigments) {
-            if (slot.work && slot.work->getId() == workId) {
-                if (slot.reservedBy != student) {
-                    cout << "этим заданием занят не этот студент\n";
-                    return false;
-                }
-                cout << "студент " << student->getName()
-                     << " спрыгнул с задания #" << workId << "\n";
-                slot.reservedBy = nullptr;
-                slot.submitted = false;
-                slot.approved = false;
-                slot.grade = 0;
-                return true;
-            }
+    bool dropWork(int workId, Student* student, uint64_t* newState = nullptr) {
+        size_t i = findSlot(workId);
+        if (i == NO_SLOT) {
+            cout << "задание с id " << workId << " не найдено\n";
+            return false;
         }
-        cout << "задание с id " << workId << " не найдено\n";
-        return false;
+        uint64_t next = 0;
+        if (!releaseSlot(i, student->getId(), next)) {
+            cout << "этим заданием занят не этот студент\n";
+            return false;
+        }
+        if (newState) *newState = next;
+        chatter() << "студент " << student->getName()
+                  << " спрыгнул с задания #" << workId << "\n";
+        return true;
     }
-    ~Subject() {
-        for (auto& slot : assigments) {
-            delete slot.work;   // освобождаем каждую работу
+    //восстановить состояние слота из снимка (без проверок и вывода)
+    bool restoreSlot(int workId, Student* student, bool submitted, bool approved, int grade, uint32_t slotVersion = 0) {
+        size_t i = findSlot(workId);
+        if (i == NO_SLOT) return false;
+        uint8_t status = 0;
+        if (student) {
+            status = static_cast<uint8_t>(SLOT_RESERVED | (submitted ? SLOT_SUBMITTED : 0) | (approved ? SLOT_APPROVED : 0));
         }
+        return setState(i, slotword::make(status, student ? student->getId() : 0, student ? grade : 0, slotVersion));
+    }
+    //применить слово из журнала, если оно новее текущего: записи одного слота из разных потоков
+    //могут лечь в журнал не в том порядке, в каком прошли CAS
+    bool applyState(int workId, uint64_t word) {
+        size_t i = findSlot(workId);
+        if (i == NO_SLOT) return false;
+        if (!slotword::newer(word, loadState(i))) return true;
+        return setState(i, word);
     }
-    
 };
 
-/** @brief Университетская система */
-class UniversitySystem {
-    private:
-        // списки указателей на объекты
-        vector<Student*> students;
-        vector<Teacher*> teachers;
-        vector<Subject*> subjects;
-    
-        int nextUserId = 1;      // следующий id для пользователя
-        int nextSubjectId = 1;   // следующий id для предмета
-        int nextWorkId = 1;      // следующий id для работы
-    
-    public:
-        // добавление преподавателя
-        void addTeacher() {
-            cin.ignore(numeric_limits<streamsize>::max(), '\n'); // чистим буфер
-            string name;
-            cout << "введите имя преподавателя: ";
-            getline(cin, name);
-    
-            Teacher* t = new Teacher(nextUserId++, name);
-            teachers.push_back(t);
-    
-            cout << "преподаватель добавлен, id = " << t->getId() << "\n";
+const int GRADE_BUCKETS = 11; //гистограмма по оценкам 0..10, остальное - в outliers
+
+/** @brief Сводка по слотам: статусы и оценки утверждённых работ */
+struct SlotStats {
+    size_t freeSlots = 0;
+    size_t reserved = 0;  //записан, ещё не сдал
+    size_t submitted = 0; //сдал, ждёт проверки
+    size_t approved = 0;
+    long long gradeSum = 0;
+    size_t histogram[GRADE_BUCKETS] = {};
+    vector<int> outliers; //оценки вне 0..10, их мало, храним как есть
+
+    size_t total() const {
+        return freeSlots + reserved + submitted + approved;
+    }
+    double mean() const {
+        return approved ? static_cast<double>(gradeSum) / approved : 0.0;
+    }
+    //k-я по порядку оценка (с нуля): сначала отрицательные выбросы, потом гистограмма, потом большие
+    int kth(size_t k) const {
+        vector<int> low, high;
+        for (int g : outliers) (g < 0 ? low : high).push_back(g);
+        sort(low.begin(), low.end());
+        sort(high.begin(), high.end());
+        if (k < low.size()) return low[k];
+        k -= low.size();
+        for (int g = 0; g < GRADE_BUCKETS; ++g) {
+            if (k < histogram[g]) return g;
+            k -= histogram[g];
         }
-    
-        // добавление студента
-        void addStudent() {
-            cin.ignore(numeric_limits<streamsize>::max(), '\n');
-            string name;
-            string group;
-    
-            cout << "введите имя студента: ";
-            getline(cin, name);
-            cout << "введите группу: ";
-            getline(cin, group);
-    
-            Student* s = new Student(nextUserId++, name, group);
-            students.push_back(s);
-    
-            cout << "студент добавлен, id = " << s->getId() << "\n";
+        return k < high.size() ? high[k] : 0;
+    }
+    double median() const {
+        if (approved == 0) return 0.0;
+        if (approved % 2 == 1) return kth(approved / 2);
+        return (kth(approved / 2 - 1) + kth(approved / 2)) / 2.0;
+    }
+    void merge(const SlotStats& other) {
+        freeSlots += other.freeSlots;
+        reserved += other.reserved;
+        submitted += other.submitted;
+        approved += other.approved;
+        gradeSum += other.gradeSum;
+        for (int g = 0; g < GRADE_BUCKETS; ++g) histogram[g] += other.histogram[g];
+        outliers.insert(outliers.end(), other.outliers.begin(), other.outliers.end());
+    }
+};
+
+//ядра агрегации по столбцу слов состояния слотов: AVX2 / SSE2 / скалярное, выбор при запуске.
+//слова читаются без блокировки, пока их меняют CAS: каждое 8-байтное слово читается целиком,
+//а сводка в целом - мгновенный снимок "примерно сейчас", как и раньше
+namespace statkernels {
+
+const uint8_t STATE_MASK = SLOT_RESERVED | SLOT_SUBMITTED | SLOT_APPROVED;
+const uint8_t STATE_RESERVED = SLOT_RESERVED;
+const uint8_t STATE_SUBMITTED = SLOT_RESERVED | SLOT_SUBMITTED;
+const uint8_t STATE_APPROVED = SLOT_RESERVED | SLOT_SUBMITTED | SLOT_APPROVED;
+
+inline void addGrade(int g, SlotStats& out) {
+    out.gradeSum += g;
+    if (g >= 0 && g < GRADE_BUCKETS) ++out.histogram[g];
+    else out.outliers.push_back(g);
+}
+
+//обработать хвост [from, n) обычным циклом
+inline void scalarRange(const uint64_t* words, size_t from, size_t n, SlotStats& out) {
+    for (size_t i = from; i < n; ++i) {
+        uint64_t w = __atomic_load_n(&words[i], __ATOMIC_RELAXED);
+        uint8_t st = slotword::status(w) & STATE_MASK;
+        if (st == 0) {
+            ++out.freeSlots;
+        } else if (st == STATE_RESERVED) {
+            ++out.reserved;
+        } else if (st == STATE_SUBMITTED) {
+            ++out.submitted;
+        } else if (st == STATE_APPROVED) {
+            ++out.approved;
+            addGrade(slotword::grade(w), out);
         }
-    
-        // найти преподавателя по id
-        Teacher* findTeacherById(int id) {
-            for (auto* t : teachers) {
-                if (t->getId() == id) return t;
-            }
-            return nullptr;
+    }
+}
+
+inline void scalar(const uint64_t* words, size_t n, SlotStats& out) {
+    scalarRange(words, 0, n, out);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+//SSE2 есть на любом x86-64, поэтому это базовый векторный вариант.
+//64-битного сравнения в SSE2 нет, но статус целиком в младшей половине слова, её и сравниваем.
+//векторные чтения идут мимо атомиков намеренно (см. выше), поэтому tsan их не проверяет
+__attribute__((no_sanitize("thread")))
+inline size_t sse2(const uint64_t* words, size_t n, SlotStats& out) {
+    const __m128i mask = _mm_set1_epi64x(STATE_MASK);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i vRes = _mm_set1_epi64x(STATE_RESERVED);
+    const __m128i vSub = _mm_set1_epi64x(STATE_SUBMITTED);
+    const __m128i vApp = _mm_set1_epi64x(STATE_APPROVED);
+    const int lowHalves = 0x5; // биты movemask_ps для младших 32 бит каждого слова
+
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i w0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(words + i));
+        __m128i w1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(words + i + 2));
+        __m128i st0 = _mm_and_si128(w0, mask);
+        __m128i st1 = _mm_and_si128(w1, mask);
+        auto count = [&](__m128i v) {
+            return __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(st0, v))) & lowHalves) +
+                   __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(st1, v))) & lowHalves);
+        };
+        out.freeSlots += count(zero);
+        out.reserved += count(vRes);
+        out.submitted += count(vSub);
+        int app = (_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(st0, vApp))) & lowHalves) |
+                  ((_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(st1, vApp))) & lowHalves) << 4);
+        if (app == 0) continue;
+        // оценки только у утверждённых, их берём поштучно из уже прочитанных слов:
+        // повторное чтение могло бы увидеть слот, который успели поменять
+        alignas(16) uint64_t seen[4];
+        _mm_store_si128(reinterpret_cast<__m128i*>(seen), w0);
+        _mm_store_si128(reinterpret_cast<__m128i*>(seen + 2), w1);
+        for (int l = 0; l < 4; ++l) {
+            if (!(app & (1 << (l * 2)))) continue;
+            ++out.approved;
+            addGrade(slotword::grade(seen[l]), out);
         }
-    
-        // найти студента по id
-        Student* findStudentById(int id) {
-            for (auto* s : students) {
-                if (s->getId() == id) return s;
-            }
-            return nullptr;
+    }
+    return i;
+}
+
+//сколько 64-битных дорожек маски взведено
+__attribute__((target("avx2")))
+inline int lanes(__m256i m) {
+    return __builtin_popcount(static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(m))));
+}
+
+__attribute__((target("avx2"), no_sanitize("thread")))
+inline size_t avx2(const uint64_t* words, size_t n, SlotStats& out) {
+    const __m256i mask = _mm256_set1_epi64x(STATE_MASK);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i vRes = _mm256_set1_epi64x(STATE_RESERVED);
+    const __m256i vSub = _mm256_set1_epi64x(STATE_SUBMITTED);
+    const __m256i vApp = _mm256_set1_epi64x(STATE_APPROVED);
+    const __m256i gradeMask = _mm256_set1_epi64x(0xFF);
+
+    // гистограмма в 64-битных дорожках: переполнения нет, сливать по блокам не нужно
+    __m256i hist[GRADE_BUCKETS];
+    for (int g = 0; g < GRADE_BUCKETS; ++g) hist[g] = zero;
+
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i w = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + i));
+        __m256i st = _mm256_and_si256(w, mask);
+        out.freeSlots += lanes(_mm256_cmpeq_epi64(st, zero));
+        out.reserved += lanes(_mm256_cmpeq_epi64(st, vRes));
+        out.submitted += lanes(_mm256_cmpeq_epi64(st, vSub));
+        __m256i app = _mm256_cmpeq_epi64(st, vApp);
+        if (_mm256_testz_si256(app, app)) continue;
+        out.approved += lanes(app);
+
+        // поле оценки без знака: 0..10 совпадут с корзинами, отрицательные уйдут в выбросы
+        __m256i g = _mm256_and_si256(_mm256_srli_epi64(w, 32), gradeMask);
+        __m256i hit = zero;
+        for (int b = 0; b < GRADE_BUCKETS; ++b) {
+            __m256i eq = _mm256_and_si256(_mm256_cmpeq_epi64(g, _mm256_set1_epi64x(b)), app);
+            hist[b] = _mm256_sub_epi64(hist[b], eq); // -1 на каждое совпадение
+            hit = _mm256_or_si256(hit, eq);
         }
-    
-        // найти предмет по id
-        Subject* findSubjectById(int id) {
-            for (auto* sub : subjects) {
-                if (sub->getId() == id) return sub;
-            }
-            return nullptr;
+        // выбросы редкие: разбираем их сразу из загруженного вектора, чтобы не читать слоты второй раз
+        __m256i odd = _mm256_andnot_si256(hit, app);
+        if (_mm256_testz_si256(odd, odd)) continue;
+        alignas(32) uint64_t seen[4];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(seen), w);
+        int oddLanes = _mm256_movemask_pd(_mm256_castsi256_pd(odd));
+        for (int l = 0; l < 4; ++l) {
+            if (!(oddLanes & (1 << l))) continue;
+            int grade = slotword::grade(seen[l]);
+            out.gradeSum += grade;
+            out.outliers.push_back(grade);
         }
-    
-        // создать предмет
-        void addSubject() {
-            if (teachers.empty()) {
-                cout << "сначала добавьте хотя бы одного преподавателя\n";
-                return;
-            }
-    
-            cout << "список преподавателей:\n";
-            for (auto* t : teachers) {
-                cout << "  id " << t->getId() << ": " << t->getName() << "\n";
-            }
-    
-            int teacherId;
-            cout << "введите id преподавателя-владельца предмета: ";
-            cin >> teacherId;
-    
-            Teacher* owner = findTeacherById(teacherId);
-            if (!owner) {
-                cout << "преподаватель с таким id не найден\n";
-                return;
-            }
-    
-            cin.ignore(numeric_limits<streamsize>::max(), '\n');
-            string name;
-            cout << "введите название предмета: ";
-            getline(cin, name);
-    
-            Subject* subj = new Subject(nextSubjectId++, name, owner);
-            subjects.push_back(subj);
-    
-            cout << "предмет создан, id = " << subj->getId() << "\n";
+    }
+
+    alignas(32) long long counts[4];
+    for (int b = 0; b < GRADE_BUCKETS; ++b) {
+        _mm256_store_si256(reinterpret_cast<__m256i*>(counts), hist[b]);
+        size_t hits = static_cast<size_t>(counts[0] + counts[1] + counts[2] + counts[3]);
+        out.histogram[b] += hits;
+        out.gradeSum += static_cast<long long>(hits) * b;
+    }
+
+    return i;
+}
+
+inline bool useAvx2() {
+    static const bool hasAvx2 = __builtin_cpu_supports("avx2");
+    return hasAvx2;
+}
+
+#endif
+
+//выбранное при старте ядро
+inline void accumulate(const uint64_t* words, size_t n, SlotStats& out) {
+    size_t done = 0;
+#if defined(__x86_64__) || defined(__i386__)
+    done = useAvx2() ? avx2(words, n, out) : sse2(words, n, out);
+#endif
+    scalarRange(words, done, n, out);
+}
+
+inline const char* name() {
+#if defined(__x86_64__) || defined(__i386__)
+    return useAvx2() ? "avx2" : "sse2";
+#else
+    return "scalar";
+#endif
+}
+
+} // namespace statkernels
+
+const char SNAPSHOT_MAGIC[8] = {'U', 'N', 'I', 'S', 'N', 'A', 'P', '1'};
+const uint32_t SNAPSHOT_VERSION = 3; //во второй версии добавлено поколение снимка, в третьей - версии слотов
+const char* const SNAPSHOT_FILE = "university.snap";
+
+/** @brief Запись бинарных данных (снимок, журнал) в буфер */
+struct BinaryWriter {
+    string buf;
+
+    void putBytes(const void* data, size_t len) {
+        buf.append(static_cast<const char*>(data), len);
+    }
+    void putU8(uint8_t v) { putBytes(&v, sizeof v); }
+    void putU32(uint32_t v) { putBytes(&v, sizeof v); }
+    void putU64(uint64_t v) { putBytes(&v, sizeof v); }
+    void putI32(int32_t v) { putBytes(&v, sizeof v); }
+    void putString(string_view str) {
+        putU32(static_cast<uint32_t>(str.size()));
+        putBytes(str.data(), str.size());
+    }
+};
+
+/** @brief Чтение бинарных данных прямо из отображённой памяти */
+struct BinaryReader {
+    const char* cur;
+    const char* end;
+    bool ok = true; //станет false при выходе за границы файла
+
+    bool getBytes(void* dst, size_t len) {
+        if (!ok || static_cast<size_t>(end - cur) < len) {
+            ok = false;
+            return false;
         }
-    
-        // записать студента на предмет (просто добавляем его в список студентов предмета)
-        void enrollStudentToSubject() {
-            if (subjects.empty() || students.empty()) {
-                cout << "нет предметов или студентов\n";
-                return;
-            }
-    
-            int subjId, studId;
-            cout << "введите id предмета: ";
-            cin >> subjId;
-            cout << "введите id студента: ";
-            cin >> studId;
-    
-            Subject* subj = findSubjectById(subjId);
-            Student* stud = findStudentById(studId);
-    
-            if (!subj || !stud) {
-                cout << "неверный id предмета или студента\n";
-                return;
-            }
-    
-            subj->addStudent(stud);
-            cout << "студент добавлен на предмет\n";
+        memcpy(dst, cur, len);
+        cur += len;
+        return true;
+    }
+    uint8_t getU8() { uint8_t v = 0; getBytes(&v, sizeof v); return v; }
+    uint32_t getU32() { uint32_t v = 0; getBytes(&v, sizeof v); return v; }
+    uint64_t getU64() { uint64_t v = 0; getBytes(&v, sizeof v); return v; }
+    int32_t getI32() { int32_t v = 0; getBytes(&v, sizeof v); return v; }
+    //смотрит прямо в отображённый файл: живёт, пока жив файл
+    string_view getStringView() {
+        uint32_t len = getU32();
+        if (!ok || static_cast<size_t>(end - cur) < len) {
+            ok = false;
+            return string_view();
         }
-    
-        // добавить задание на предмет (доклад/лаба)
-        void addWorkToSubject() {
-            if (subjects.empty()) {
-                cout << "нет предметов\n";
-                return;
-            }
-    
+        string_view str(cur, len);
+        cur += len;
+        return str;
+    }
+};
+
+/** @brief Отображение файла в память только для чтения */
+struct MappedFile {
+    const char* data = nullptr;
+    size_t size = 0;
+
+    bool open(const string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+            ::close(fd);
+            return false;
+        }
+        void* p = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) return false;
+        data = static_cast<const char*>(p);
+        size = static_cast<size_t>(st.st_size);
+        madvise(p, size, MADV_SEQUENTIAL);
+        return true;
+    }
+    ~MappedFile() {
+        if (data) munmap(const_cast<char*>(data), size);
+    }
+};
+
+/** @brief Поток-заглушка, глотает весь вывод (нужен при воспроизведении журнала) */
+class NullBuffer : public streambuf {
+    protected:
+    int overflow(int c) override { return c; }
+    streamsize xsputn(const char*, streamsize n) override { return n; }
+};
+
+/** @brief Временно глушит cout, пока объект жив */
+class MuteCout {
+    private:
+    NullBuffer sink;
+    streambuf* saved;
+
+    public:
+    MuteCout() : saved(cout.rdbuf(&sink)) {}
+    ~MuteCout() { cout.rdbuf(saved); }
+};
+
+const char JOURNAL_MAGIC[8] = {'U', 'N', 'I', 'J', 'R', 'N', 'L', '2'};
+const char JOURNAL_MAGIC_V1[8] = {'U', 'N', 'I', 'J', 'R', 'N', 'L', '1'}; //слова слотов с 16-битной версией
+const char* const JOURNAL_FILE = "university.journal";
+const size_t JOURNAL_GROUP_COMMIT = 256;   // сколько записей копим до одного fsync
+const size_t JOURNAL_COMPACT_EVERY = 50000; // после стольких записей делаем новый снимок
+
+/** @brief Виды записей журнала */
+enum class JournalOp : uint8_t {
+    AddTeacher = 1,
+    AddStudent,
+    AddSubject,
+    AddWork,
+    Enroll,
+    EnrollMany,
+    Reserve,
+    Submit,
+    Approve,
+    Reject,
+    Drop,
+    SlotState // слово состояния слота после перехода, заменяет пять записей выше
+};
+
+//контрольная сумма записи, чтобы отличить недописанный хвост после сбоя
+inline uint32_t journalChecksum(const char* data, size_t len) {
+    uint32_t h = 2166136261u; // FNV-1a
+    for (size_t i = 0; i < len; ++i) {
+        h ^= static_cast<uint8_t>(data[i]);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/** @brief Журнал изменений между снимками (только дописывание в конец) */
+class Journal {
+    private:
+    int fd = -1;
+    mutable mutex guard;      // дописывают из разных потоков
+    string pending;           // записи, ещё не отданные на диск
+    size_t pendingRecords = 0;
+    size_t records = 0;       // сколько записей с последнего снимка
+    off_t durableSize = 0;    // до этого места файл целиком из записей, дошедших до диска
+
+    bool writeAll(const char* data, size_t len) {
+        while (len > 0) {
+            ssize_t n = ::write(fd, data, len);
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0) return false;
+            data += n;
+            len -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    // при ошибке записи остаются в pending и уйдут при следующей попытке
+    bool flushPending() {
+        if (fd < 0) return false;
+        if (pending.empty()) return true;
+        METRIC_TIME(JournalCommit);
+        if (!writeAll(pending.data(), pending.size()) || fdatasync(fd) != 0) {
+            // срезаем то, что успело попасть в файл, иначе повтор оставит внутри рваную запись
+            if (ftruncate(fd, durableSize) != 0 || lseek(fd, durableSize, SEEK_SET) < 0) {
+                cout << "ошибка: не удалось откатить журнал к последней целой записи\n";
+            }
+            cout << "ошибка: не удалось записать журнал\n";
+            return false;
+        }
+        durableSize += static_cast<off_t>(pending.size());
+        pending.clear();
+        pendingRecords = 0;
+        return true;
+    }
+
+    public:
+    Journal() = default;
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+
+    // открыть журнал для дописывания; validSize - сколько байт прошло проверку при воспроизведении
+    bool open(const string& path, uint64_t generation, size_t validSize, size_t replayed) {
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT, 0644);
+        if (fd < 0) {
+            cout << "ошибка: не удалось открыть журнал " << path << "\n";
+            return false;
+        }
+        if (validSize == 0) {
+            return reset(generation);
+        }
+        // отрезаем недописанный хвост, если он был
+        if (ftruncate(fd, static_cast<off_t>(validSize)) != 0 || lseek(fd, 0, SEEK_END) < 0) {
+            return reset(generation);
+        }
+        durableSize = static_cast<off_t>(validSize);
+        records = replayed;
+        return true;
+    }
+
+    // начать журнал заново поверх снимка с указанным поколением
+    bool reset(uint64_t generation) {
+        lock_guard<mutex> lock(guard);
+        if (fd < 0) return false;
+        pending.clear();
+        pendingRecords = 0;
+        records = 0;
+
+        BinaryWriter header;
+        header.putBytes(JOURNAL_MAGIC, sizeof JOURNAL_MAGIC);
+        header.putU64(generation);
+        if (ftruncate(fd, 0) != 0 || lseek(fd, 0, SEEK_SET) < 0 ||
+            !writeAll(header.buf.data(), header.buf.size()) || fdatasync(fd) != 0) {
+            cout << "ошибка: не удалось сбросить журнал\n";
+            return false;
+        }
+        durableSize = static_cast<off_t>(header.buf.size());
+        return true;
+    }
+
+    // добавить запись; на диск уходит пачкой раз в JOURNAL_GROUP_COMMIT записей
+    void append(const BinaryWriter& rec) {
+        if (fd < 0) return;
+        BinaryWriter frame;
+        frame.putU32(static_cast<uint32_t>(rec.buf.size()));
+        frame.putU32(journalChecksum(rec.buf.data(), rec.buf.size()));
+        lock_guard<mutex> lock(guard);
+        pending += frame.buf;
+        pending += rec.buf;
+        ++pendingRecords;
+        ++records;
+        // если диск отказал, следующая попытка - через ещё одну пачку, а не на каждой записи
+        if (pendingRecords % JOURNAL_GROUP_COMMIT == 0) {
+            flushPending();
+        }
+    }
+
+    // сбросить накопленные записи и дождаться диска; false - записи пока только в памяти
+    bool commit() {
+        lock_guard<mutex> lock(guard);
+        return fd < 0 || flushPending();
+    }
+
+    size_t recordsSinceSnapshot() const {
+        lock_guard<mutex> lock(guard);
+        return records;
+    }
+
+    ~Journal() {
+        commit();
+        if (fd >= 0) ::close(fd);
+    }
+};
+
+/** @brief Что импортируем из CSV */
+enum class ImportKind {
+    Teachers, // имя
+    Students, // имя,группа
+    Subjects, // id преподавателя,название
+    Works     // id предмета,тип (report/lab),название
+};
+
+/** @brief Строка CSV, поля смотрят прямо в отображённый файл */
+struct CsvRow {
+    size_t line;
+    string_view fields[3];
+};
+
+/** @brief Результат разбора одного куска файла */
+struct CsvChunk {
+    vector<CsvRow> rows;
+    vector<pair<size_t, string>> errors; // номер строки внутри куска и причина
+    size_t lines = 0;
+};
+
+inline string_view trimField(string_view f) {
+    while (!f.empty() && (f.front() == ' ' || f.front() == '\t')) f.remove_prefix(1);
+    while (!f.empty() && (f.back() == ' ' || f.back() == '\t' || f.back() == '\r')) f.remove_suffix(1);
+    return f;
+}
+
+//снять кавычки с поля ("" внутри превращается в "); результат смотрит в файл,
+//копия в scratch нужна только полю с "" внутри
+inline string_view unquoteField(string_view f, string& scratch) {
+    if (f.size() < 2 || f.front() != '"' || f.back() != '"') return f;
+    f = f.substr(1, f.size() - 2);
+    size_t quote = f.find('"');
+    if (quote == string_view::npos) return f;
+    scratch.assign(f.data(), quote);
+    for (size_t i = quote; i < f.size(); ++i) {
+        scratch += f[i];
+        if (f[i] == '"' && i + 1 < f.size() && f[i + 1] == '"') ++i;
+    }
+    return scratch;
+}
+
+//разобрать кусок [begin, end), который начинается и заканчивается на границе строки
+inline void parseCsvChunk(const char* begin, const char* end, size_t expectedFields, CsvChunk& chunk) {
+    const char* p = begin;
+    while (p < end) {
+        const char* eol = static_cast<const char*>(memchr(p, '\n', static_cast<size_t>(end - p)));
+        if (!eol) eol = end;
+        string_view line(p, static_cast<size_t>(eol - p));
+        p = eol + 1;
+        ++chunk.lines;
+
+        line = trimField(line);
+        if (line.empty() || line.front() == '#') continue;
+
+        CsvRow row{chunk.lines, {}};
+        size_t count = 0;
+        bool inQuotes = false;
+        size_t start = 0;
+        for (size_t i = 0; i <= line.size(); ++i) {
+            if (i < line.size() && line[i] == '"') {
+                inQuotes = !inQuotes;
+                continue;
+            }
+            if (i == line.size() || (line[i] == ',' && !inQuotes)) {
+                if (count < expectedFields) {
+                    row.fields[count] = trimField(line.substr(start, i - start));
+                }
+                ++count;
+                start = i + 1;
+            }
+        }
+        if (inQuotes) {
+            chunk.errors.push_back({chunk.lines, "незакрытая кавычка"});
+        } else if (count != expectedFields) {
+            chunk.errors.push_back({chunk.lines, "ожидалось полей: " + to_string(expectedFields) +
+                                                 ", получено: " + to_string(count)});
+        } else {
+            chunk.rows.push_back(row);
+        }
+    }
+}
+
+//режем файл на куски по границам строк и разбираем их параллельно
+inline vector<CsvChunk> parseCsvParallel(const char* data, size_t size, size_t expectedFields) {
+    size_t workers = max<size_t>(1, thread::hardware_concurrency());
+    const size_t minChunk = 1 << 16; // мелкие файлы не дробим
+    workers = max<size_t>(1, min(workers, size / minChunk));
+
+    vector<const char*> bounds{data};
+    for (size_t i = 1; i < workers; ++i) {
+        const char* cut = data + size * i / workers;
+        if (cut <= bounds.back()) continue;
+        const char* eol = static_cast<const char*>(memchr(cut, '\n', static_cast<size_t>(data + size - cut)));
+        if (!eol) break;
+        bounds.push_back(eol + 1);
+    }
+    bounds.push_back(data + size);
+
+    vector<CsvChunk> chunks(bounds.size() - 1);
+    vector<thread> pool;
+    for (size_t i = 1; i < chunks.size(); ++i) {
+        pool.emplace_back(parseCsvChunk, bounds[i], bounds[i + 1], expectedFields, ref(chunks[i]));
+    }
+    parseCsvChunk(bounds[0], bounds[1], expectedFields, chunks[0]);
+    for (auto& t : pool) t.join();
+
+    // переводим номера строк из локальных в сквозные
+    size_t offset = 0;
+    for (auto& chunk : chunks) {
+        for (auto& row : chunk.rows) row.line += offset;
+        for (auto& err : chunk.errors) err.first += offset;
+        offset += chunk.lines;
+    }
+    return chunks;
+}
+
+/** @brief Итог импорта */
+struct ImportResult {
+    size_t rows = 0;      // строк с данными, включая те, что не удалось разобрать
+    size_t imported = 0;
+    vector<string> errors;
+    double seconds = 0;
+};
+
+/** @brief Формат выгружаемого отчёта */
+enum class ReportFormat {
+    Text, // человекочитаемый, как раньше
+    Csv,
+    Json
+};
+
+inline const char* reportExtension(ReportFormat format) {
+    switch (format) {
+    case ReportFormat::Csv: return ".csv";
+    case ReportFormat::Json: return ".json";
+    default: return ".txt";
+    }
+}
+
+inline bool parseReportFormat(const string& name, ReportFormat& format) {
+    if (name.empty() || name == "text" || name == "txt") format = ReportFormat::Text;
+    else if (name == "csv") format = ReportFormat::Csv;
+    else if (name == "json") format = ReportFormat::Json;
+    else return false;
+    return true;
+}
+
+//число пишем прямо в буфер, без временной строки
+inline void appendInt(string& out, long long value) {
+    char digits[24];
+    auto res = to_chars(digits, digits + sizeof digits, value);
+    out.append(digits, static_cast<size_t>(res.ptr - digits));
+}
+
+//поле CSV: в кавычки берём только если внутри есть разделитель, кавычка или перевод строки
+inline void appendCsvField(string& out, string_view field) {
+    if (field.find_first_of(",\"\n\r") == string_view::npos) {
+        out.append(field.data(), field.size());
+        return;
+    }
+    out += '"';
+    size_t start = 0;
+    for (size_t i = 0; i < field.size(); ++i) {
+        if (field[i] == '"') {
+            out.append(field.data() + start, i - start + 1);
+            out += '"';
+            start = i + 1;
+        }
+    }
+    out.append(field.data() + start, field.size() - start);
+    out += '"';
+}
+
+//строка JSON с экранированием; куски без спецсимволов копируем целиком
+inline void appendJsonString(string& out, string_view text) {
+    out += '"';
+    size_t start = 0;
+    for (size_t i = 0; i < text.size(); ++i) {
+        unsigned char ch = static_cast<unsigned char>(text[i]);
+        if (ch != '"' && ch != '\\' && ch >= 0x20) continue;
+        out.append(text.data() + start, i - start);
+        switch (ch) {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default: {
+            static const char hex[] = "0123456789abcdef";
+            out += "\\u00";
+            out += hex[ch >> 4];
+            out += hex[ch & 15];
+        }
+        }
+        start = i + 1;
+    }
+    out.append(text.data() + start, text.size() - start);
+    out += '"';
+}
+
+/** @brief Университетская система
+ *
+ * Операции можно звать из многих потоков. Каждая проходит stateGate (снимок ждёт, пока
+ * начатые закончатся), дальше порядок блокировок: предмет -> студент и журнал.
+ * Переходы слотов блокировок предмета не берут, только CAS по слову и потом индекс студента.
+ * listsLock держится только пока копируются или пополняются списки.
+ */
+class UniversitySystem {
+    private:
+        // списки указателей на объекты
+        vector<Student*> students;
+        vector<Teacher*> teachers;
+        vector<Subject*> subjects;
+
+        // сами объекты живут в пулах и освобождаются разом
+        ObjectPool<Student> studentPool;
+        ObjectPool<Teacher> teacherPool;
+        ObjectPool<Subject> subjectPool;
+        WorkPools workPools;
+
+        // имена, группы и названия: каждый различный текст один раз, объекты держат ручки
+        StringPool strings;
+
+        // индексы по id (студенты и преподы делят nextUserId, поэтому таблицы разные)
+        IdRegistry<Student> studentIndex;
+        IdRegistry<Teacher> teacherIndex;
+        IdRegistry<Subject> subjectIndex;
+
+        // общая сводка по статусам слотов: полосы, чтобы предметы не толкались на одной линии кеша
+        static const int ROLLUP_STRIPES = 16;
+        SlotCounters rollup[ROLLUP_STRIPES];
+        SlotCounters& rollupFor(int subjId) {
+            return rollup[subjId % ROLLUP_STRIPES];
+        }
+
+        // вторичный индекс: группа (id интернированной строки) -> её студенты в порядке создания
+        unordered_map<uint32_t, vector<Student*>> groupIndex;
+
+        // манифест выгрузки: (предмет, формат) -> версия предмета и размер файла, что уже на диске
+        struct ExportedReport {
+            uint64_t version;
+            size_t bytes;
+            ino_t inode;       // редактор мог заменить файл целиком
+            timespec modified; // st_mtim
+            timespec changed;  // st_ctim: меняется при любой записи, руками назад не выставить
+        };
+        mutable mutex manifestLock;
+        mutable unordered_map<uint64_t, ExportedReport> exportManifest;
+
+        // поиск по имени, группе и названиям; пополняется при регистрации объектов и заданий.
+        // после загрузки при старте не пополняется: строится одним проходом при первом поиске
+        mutable SearchIndex searchIndex;
+        mutable atomic<bool> searchStale{false};
+    
+        atomic<int> nextUserId{1};      // следующий id для пользователя
+        atomic<int> nextSubjectId{1};   // следующий id для предмета
+        atomic<int> nextWorkId{1};      // следующий id для работы
+
+        mutable shared_mutex listsLock; // списки и индекс групп выше
+        mutable QuiesceGate stateGate;  // операции входят, снимок закрывает вход и ждёт точки покоя
+
+        Journal journal;
+        uint64_t snapshotGeneration = 0; // поколение последнего снимка, журнал привязан к нему
+        bool replaying = false;          // при воспроизведении журнала ничего не пишем обратно
+        bool legacyJournal = false;      // воспроизводится журнал первой версии (старая раскладка слова слота)
+
+        // заготовка записи журнала
+        BinaryWriter journalRecord(JournalOp op) const {
+            BinaryWriter rec;
+            rec.putU8(static_cast<uint8_t>(op));
+            return rec;
+        }
+        // сворачивать журнал посреди операции нельзя, это делает maybeCompact между командами
+        void journalAppend(const BinaryWriter& rec) {
+            if (replaying) return;
+            journal.append(rec);
+        }
+        static void raiseTo(atomic<int>& counter, int value) {
+            int cur = counter.load();
+            while (cur < value && !counter.compare_exchange_weak(cur, value)) {
+            }
+        }
+        // переход слота пишется готовым словом состояния: при воспроизведении его версия
+        // расставит по местам записи, которые потоки успели дописать не в том порядке
+        void journalSlotState(int subjId, int workId, uint64_t word) {
+            BinaryWriter rec = journalRecord(JournalOp::SlotState);
+            rec.putI32(subjId);
+            rec.putI32(workId);
+            rec.putU64(word);
+            journalAppend(rec);
+        }
+
+        // применить одну запись журнала, false если запись не разобрать
+        bool applyJournalRecord(BinaryReader& in) {
+            JournalOp op = static_cast<JournalOp>(in.getU8());
+            switch (op) {
+            case JournalOp::AddTeacher: {
+                int id = in.getI32();
+                string_view name = in.getStringView();
+                if (!in.ok || id <= 0 || findTeacherById(id) || findStudentById(id)) return false;
+                registerTeacher(teacherPool.create(id, strings.keep(name)));
+                raiseTo(nextUserId, id + 1);
+                return true;
+            }
+            case JournalOp::AddStudent: {
+                int id = in.getI32();
+                string_view name = in.getStringView();
+                string_view group = in.getStringView();
+                if (!in.ok || id <= 0 || findTeacherById(id) || findStudentById(id)) return false;
+                registerStudent(studentPool.create(id, strings.keep(name), strings.intern(group)));
+                raiseTo(nextUserId, id + 1);
+                return true;
+            }
+            case JournalOp::AddSubject: {
+                int id = in.getI32();
+                int ownerId = in.getI32();
+                string_view name = in.getStringView();
+                if (!in.ok || id <= 0 || findSubjectById(id)) return false;
+                registerSubject(subjectPool.create(id, strings.intern(name), findTeacherById(ownerId), workPools, studentIndex, rollupFor(id)));
+                raiseTo(nextSubjectId, id + 1);
+                return true;
+            }
+            case JournalOp::AddWork: {
+                int subjId = in.getI32();
+                int workId = in.getI32();
+                uint8_t type = in.getU8();
+                string_view title = in.getStringView();
+                Subject* subj = findSubjectById(subjId);
+                if (!in.ok || !subj || workId <= 0 || type > 1) return false;
+                auto lock = subj->writeLock();
+                placeWork(subj, type == 0 ? WorkType::Report : WorkType::Lab, workId, title);
+                raiseTo(nextWorkId, workId + 1);
+                return true;
+            }
+            case JournalOp::Enroll: {
+                int subjId = in.getI32();
+                int studId = in.getI32();
+                if (!in.ok) return false;
+                enrollStudentToSubject(subjId, studId);
+                return true;
+            }
+            case JournalOp::EnrollMany: {
+                Subject* subj = findSubjectById(in.getI32());
+                uint32_t count = in.getU32();
+                vector<Student*> members;
+                for (uint32_t i = 0; i < count && in.ok; ++i) {
+                    Student* st = findStudentById(in.getI32());
+                    if (st) members.push_back(st);
+                }
+                if (!in.ok || !subj) return false;
+                auto lock = subj->writeLock();
+                subj->addStudents(members);
+                return true;
+            }
+            // журналы до слов состояния: переходы повторяются как есть
+            case JournalOp::Reserve:
+            case JournalOp::Submit:
+            case JournalOp::Approve:
+            case JournalOp::Reject:
+            case JournalOp::Drop: {
+                int subjId = in.getI32();
+                int arg = in.getI32();
+                int workId = in.getI32();
+                if (!in.ok) return false;
+                if (op == JournalOp::Reserve) reserveWorkOnSubject(subjId, arg, workId);
+                else if (op == JournalOp::Submit) studentSubmitWork(subjId, arg, workId);
+                else if (op == JournalOp::Approve) approveWorkOnSubject(subjId, workId, arg);
+                else if (op == JournalOp::Reject) rejectWorkOnSubject(subjId, workId);
+                else dropWorkOnSubject(subjId, arg, workId);
+                return true;
+            }
+            case JournalOp::SlotState: {
+                Subject* subj = findSubjectById(in.getI32());
+                int workId = in.getI32();
+                uint64_t word = in.getU64();
+                if (!in.ok || !subj) return false;
+                if (legacyJournal) word = slotword::fromV1(word);
+                return subj->applyState(workId, word);
+            }
+            }
+            return false;
+        }
+
+        // воспроизвести журнал поверх загруженного снимка; возвращает длину целой части файла
+        // обрезать журнал можно только по битой контрольной сумме или недописанному хвосту;
+        // целую запись, которую не принял предметный слой, пропускаем и считаем в rejected
+        size_t replayJournal(const string& path, size_t& applied, size_t& rejected) {
+            applied = 0;
+            rejected = 0;
+            MappedFile file;
+            if (!file.open(path)) return 0;
+
+            BinaryReader in{file.data, file.data + file.size};
+            char magic[sizeof JOURNAL_MAGIC];
+            if (!in.getBytes(magic, sizeof magic)) return 0;
+            legacyJournal = memcmp(magic, JOURNAL_MAGIC_V1, sizeof magic) == 0;
+            if (!legacyJournal && memcmp(magic, JOURNAL_MAGIC, sizeof magic) != 0) return 0;
+            // журнал от другого снимка (сбой между снимком и сбросом журнала) - его записи уже в снимке
+            if (in.getU64() != snapshotGeneration || !in.ok) return 0;
+
+            MuteCout mute;
+            replaying = true;
+            size_t validSize = static_cast<size_t>(in.cur - file.data);
+            while (in.cur < in.end) {
+                uint32_t len = in.getU32();
+                uint32_t sum = in.getU32();
+                if (!in.ok || static_cast<size_t>(in.end - in.cur) < len ||
+                    journalChecksum(in.cur, len) != sum) {
+                    break; // недописанный хвост
+                }
+                BinaryReader rec{in.cur, in.cur + len};
+                if (applyJournalRecord(rec)) ++applied;
+                else ++rejected;
+                in.cur += len;
+                validSize = static_cast<size_t>(in.cur - file.data);
+            }
+            replaying = false;
+            return validSize;
+        }
+
+        // свернуть журнал в новый снимок (в точке покоя stateGate)
+        bool compact() {
+            // если журнал не записался, не страшно: снимок всё равно содержит эти изменения
+            journal.commit();
+            if (!saveSnapshot(SNAPSHOT_FILE, snapshotGeneration + 1)) return false;
+            ++snapshotGeneration;
+            return journal.reset(snapshotGeneration);
+        }
+
+        // регистрация готовых объектов в списках и индексах
+        // в индекс объект попадает последним: кто его нашёл, тот видит и запись о нём в журнале
+        void registerTeacher(Teacher* t) {
+            {
+                unique_lock<shared_mutex> lock(listsLock);
+                teachers.push_back(t);
+            }
+            teacherIndex.put(t->getId(), t);
+            if (!searchStale.load(memory_order_acquire)) searchIndex.add(SearchKind::Teacher, t->getId(), 0, {t->getName()});
+        }
+        void registerStudent(Student* s) {
+            {
+                unique_lock<shared_mutex> lock(listsLock);
+                students.push_back(s);
+                groupIndex[s->groupHandle().id()].push_back(s);
+            }
+            studentIndex.put(s->getId(), s);
+            if (!searchStale.load(memory_order_acquire)) searchIndex.add(SearchKind::Student, s->getId(), 0, {s->getName(), s->getGroup()});
+        }
+        void registerSubject(Subject* subj) {
+            {
+                unique_lock<shared_mutex> lock(listsLock);
+                subjects.push_back(subj);
+            }
+            subjectIndex.put(subj->getId(), subj);
+            if (!searchStale.load(memory_order_acquire)) searchIndex.add(SearchKind::Subject, subj->getId(), 0, {subj->getName()});
+        }
+        // задание на предмет и в поиск (под writeLock предмета)
+        void placeWork(Subject* subj, WorkType type, int workId, string_view title) {
+            subj->addWork(type, workId, strings.intern(title));
+            if (!searchStale.load(memory_order_acquire)) searchIndex.add(SearchKind::Work, workId, subj->getId(), {title});
+        }
+
+        // достроить поиск после загрузки. Регистрация идёт внутри stateGate, здесь вход закрыт:
+        // всё, что зарегистрировано до сборки, попадёт в проход, всё после - добавится само
+        void ensureSearchIndex() const {
+            if (!searchStale.load(memory_order_acquire)) return;
+            auto quiet = stateGate.quiesce();
+            if (!searchStale.load(memory_order_relaxed)) return;
+            searchIndex.clear();
+            shared_lock<shared_mutex> lists(listsLock);
+            for (auto* t : teachers) searchIndex.add(SearchKind::Teacher, t->getId(), 0, {t->getName()});
+            for (auto* st : students) searchIndex.add(SearchKind::Student, st->getId(), 0, {st->getName(), st->getGroup()});
+            for (auto* subj : subjects) {
+                searchIndex.add(SearchKind::Subject, subj->getId(), 0, {subj->getName()});
+                auto lock = subj->readLock();
+                for (size_t i = 0; i < subj->slotCount(); ++i) {
+                    const Work* w = subj->slotAt(i).work;
+                    searchIndex.add(SearchKind::Work, w->getId(), subj->getId(), {w->getTitle()});
+                }
+            }
+            searchStale.store(false, memory_order_release);
+        }
+
+        // копии списков: по ним можно ходить и брать блокировки предметов, не держа listsLock
+        template <typename T>
+        vector<T*> snapshotOf(const vector<T*>& list) const {
+            shared_lock<shared_mutex> lock(listsLock);
+            return list;
+        }
+        template <typename T>
+        size_t countOf(const vector<T*>& list) const {
+            shared_lock<shared_mutex> lock(listsLock);
+            return list.size();
+        }
+        // копия состава группы; группы нет в пуле - значит, в ней никого нет
+        vector<Student*> groupMembers(string_view group) const {
+            InternedString handle;
+            if (!strings.find(group, handle)) return {};
+            shared_lock<shared_mutex> lock(listsLock);
+            auto it = groupIndex.find(handle.id());
+            return it == groupIndex.end() ? vector<Student*>() : it->second;
+        }
+        // слова занятых студентом слотов через его обратный индекс, без обхода предметов
+        static void collectStudentSlots(const Student* st, vector<uint64_t>& words) {
+            for (const WorkRef& ref : st->getWorks()) {
+                if (ref.slot >= ref.subject->slotCount()) continue;
+                uint64_t w = ref.subject->slotStateAt(ref.slot);
+                // пока копировали индекс, слот могли успеть освободить
+                if (slotword::reserver(w) == st->getId()) words.push_back(w);
+            }
+        }
+
+        // удалить всё и начать с чистого листа
+        void clear() {
+            subjectPool.releaseAll();
+            workPools.reports.releaseAll();
+            workPools.labs.releaseAll();
+            studentPool.releaseAll();
+            teacherPool.releaseAll();
+            students.clear();
+            teachers.clear();
+            subjects.clear();
+            studentIndex.clear();
+            teacherIndex.clear();
+            subjectIndex.clear();
+            groupIndex.clear();
+            exportManifest.clear();
+            searchIndex.clear();
+            for (auto& stripe : rollup) stripe.reset();
+            strings.clear();
+            nextUserId = 1;
+            nextSubjectId = 1;
+            nextWorkId = 1;
+            snapshotGeneration = 0;
+        }
+
+        // разбор снимка, false если файл битый
+        bool readSnapshot(BinaryReader& in) {
+            char magic[sizeof SNAPSHOT_MAGIC];
+            if (!in.getBytes(magic, sizeof magic) || memcmp(magic, SNAPSHOT_MAGIC, sizeof magic) != 0) return false;
+            uint32_t version = in.getU32();
+            if (version < 1 || version > SNAPSHOT_VERSION) return false;
+            uint64_t generation = version >= 2 ? in.getU64() : 0;
+
+            int userId = in.getI32();
+            int subjectId = in.getI32();
+            int workId = in.getI32();
+
+            uint32_t teacherCount = in.getU32();
+            teachers.reserve(teacherCount);
+            for (uint32_t i = 0; i < teacherCount && in.ok; ++i) {
+                int id = in.getI32();
+                string_view name = in.getStringView();
+                if (!in.ok || id <= 0 || id >= userId) return false;
+                registerTeacher(teacherPool.create(id, strings.keep(name)));
+            }
+
+            uint32_t studentCount = in.getU32();
+            students.reserve(studentCount);
+            for (uint32_t i = 0; i < studentCount && in.ok; ++i) {
+                int id = in.getI32();
+                string_view name = in.getStringView();
+                string_view group = in.getStringView();
+                if (!in.ok || id <= 0 || id >= userId) return false;
+                registerStudent(studentPool.create(id, strings.keep(name), strings.intern(group)));
+            }
+
+            uint32_t subjectCount = in.getU32();
+            subjects.reserve(subjectCount);
+            for (uint32_t i = 0; i < subjectCount && in.ok; ++i) {
+                int id = in.getI32();
+                int ownerId = in.getI32();
+                string_view name = in.getStringView();
+                if (!in.ok || id <= 0 || id >= subjectId) return false;
+
+                Subject* subj = subjectPool.create(id, strings.intern(name), findTeacherById(ownerId), workPools, studentIndex, rollupFor(id));
+                registerSubject(subj);
+                auto lock = subj->writeLock();
+
+                uint32_t enrolledCount = in.getU32();
+                vector<Student*> enrolled;
+                enrolled.reserve(enrolledCount);
+                for (uint32_t k = 0; k < enrolledCount && in.ok; ++k) {
+                    Student* st = findStudentById(in.getI32());
+                    if (!st) return false;
+                    enrolled.push_back(st);
+                }
+                subj->addStudents(enrolled);
+
+                uint32_t slotCount = in.getU32();
+                for (uint32_t k = 0; k < slotCount && in.ok; ++k) {
+                    int wid = in.getI32();
+                    uint8_t type = in.getU8();
+                    string_view title = in.getStringView();
+                    int reserverId = in.getI32();
+                    uint8_t flags = in.getU8();
+                    int grade = in.getI32();
+                    uint32_t slotVersion = version >= 3 ? in.getU32() : 0;
+                    if (!in.ok || wid <= 0 || wid >= workId || type > 1) return false;
+                    grade = min(max(grade, GRADE_MIN), GRADE_MAX); // старые снимки хранили оценку целым int
+
+                    placeWork(subj, type == 0 ? WorkType::Report : WorkType::Lab, wid, title);
+
+                    Student* st = nullptr;
+                    if (reserverId != 0) {
+                        st = findStudentById(reserverId);
+                        if (!st) return false;
+                    }
+                    subj->restoreSlot(wid, st, flags & 1, flags & 2, grade, slotVersion);
+                }
+            }
+            if (!in.ok) return false;
+
+            nextUserId = userId;
+            nextSubjectId = subjectId;
+            nextWorkId = workId;
+            snapshotGeneration = generation;
+            return true;
+        }
+    
+    public:
+        // ---- операции над данными, без ввода с клавиатуры ----
+
+        // добавление преподавателя
+        Teacher* addTeacher(const string& name) {
+            METRIC_TIME(AddTeacher);
+            auto op = stateGate.enter();
+            Teacher* t = teacherPool.create(nextUserId++, strings.keep(name));
+
+            BinaryWriter rec = journalRecord(JournalOp::AddTeacher);
+            rec.putI32(t->getId());
+            rec.putString(name);
+            journalAppend(rec);
+            registerTeacher(t);
+            return t;
+        }
+
+        // добавление студента
+        Student* addStudent(const string& name, const string& group) {
+            METRIC_TIME(AddStudent);
+            auto op = stateGate.enter();
+            Student* s = studentPool.create(nextUserId++, strings.keep(name), strings.intern(group));
+
+            BinaryWriter rec = journalRecord(JournalOp::AddStudent);
+            rec.putI32(s->getId());
+            rec.putString(name);
+            rec.putString(group);
+            journalAppend(rec);
+            registerStudent(s);
+            return s;
+        }
+
+        // найти преподавателя по id
+        Teacher* findTeacherById(int id) const {
+            METRIC_COUNT_CALL(FindTeacher);
+            return teacherIndex.get(id);
+        }
+    
+        // найти студента по id
+        Student* findStudentById(int id) const {
+            METRIC_COUNT_CALL(FindStudent);
+            return studentIndex.get(id);
+        }
+    
+        // найти предмет по id
+        Subject* findSubjectById(int id) const {
+            METRIC_COUNT_CALL(FindSubject);
+            return subjectIndex.get(id);
+        }
+
+        // создать предмет
+        Subject* addSubject(int teacherId, const string& name) {
+            METRIC_TIME(AddSubject);
+            auto op = stateGate.enter();
+            Teacher* owner = findTeacherById(teacherId);
+            if (!owner) {
+                cout << "преподаватель с таким id не найден\n";
+                return nullptr;
+            }
+
+            int id = nextSubjectId++;
+            Subject* subj = subjectPool.create(id, strings.intern(name), owner, workPools, studentIndex, rollupFor(id));
+
+            BinaryWriter rec = journalRecord(JournalOp::AddSubject);
+            rec.putI32(subj->getId());
+            rec.putI32(teacherId);
+            rec.putString(name);
+            journalAppend(rec);
+            registerSubject(subj);
+            return subj;
+        }
+
+        // записать студента на предмет
+        bool enrollStudentToSubject(int subjId, int studId) {
+            METRIC_TIME(Enroll);
+            auto op = stateGate.enter();
+            Subject* subj = findSubjectById(subjId);
+            Student* stud = findStudentById(studId);
+
+            if (!subj || !stud) {
+                cout << "неверный id предмета или студента\n";
+                return false;
+            }
+            // запись в журнал под той же блокировкой, чтобы порядок в журнале совпал с порядком изменений
+            auto lock = subj->writeLock();
+            if (!subj->addStudent(stud)) return false;
+
+            BinaryWriter rec = journalRecord(JournalOp::Enroll);
+            rec.putI32(subjId);
+            rec.putI32(studId);
+            journalAppend(rec);
+            return true;
+        }
+
+        // записать на предмет всех студентов группы, возвращает сколько добавилось
+        size_t enrollGroupToSubject(int subjId, const string& group) {
+            METRIC_TIME(EnrollGroup);
+            auto op = stateGate.enter();
+            Subject* subj = findSubjectById(subjId);
+            if (!subj) {
+                cout << "предмет не найден\n";
+                return 0;
+            }
+
+            vector<Student*> candidates = groupMembers(group);
+
+            auto lock = subj->writeLock();
+            vector<Student*> members;
+            for (auto* st : candidates) {
+                if (!subj->isEnrolled(st)) members.push_back(st);
+            }
+            if (members.empty()) return 0;
+
+            size_t added = subj->addStudents(members);
+
+            BinaryWriter rec = journalRecord(JournalOp::EnrollMany);
+            rec.putI32(subjId);
+            rec.putU32(static_cast<uint32_t>(members.size()));
+            for (auto* st : members) {
+                rec.putI32(st->getId());
+            }
+            journalAppend(rec);
+            return added;
+        }
+
+        // добавить задание на предмет, возвращает id работы или 0
+        int addWorkToSubject(int subjId, WorkType type, const string& title) {
+            METRIC_TIME(AddWork);
+            auto op = stateGate.enter();
+            Subject* subj = findSubjectById(subjId);
+            if (!subj) {
+                cout << "предмет не найден\n";
+                return 0;
+            }
+
+            int workId = nextWorkId++;
+            auto lock = subj->writeLock();
+            placeWork(subj, type, workId, title);
+
+            BinaryWriter rec = journalRecord(JournalOp::AddWork);
+            rec.putI32(subjId);
+            rec.putI32(workId);
+            rec.putU8(type == WorkType::Report ? 0 : 1);
+            rec.putString(title);
+            journalAppend(rec);
+            return workId;
+        }
+
+        // студент записывается на конкретное задание
+        bool reserveWorkOnSubject(int subjId, int studId, int workId) {
+            METRIC_TIME(Reserve);
+            auto op = stateGate.enter();
+            Subject* subj = findSubjectById(subjId);
+            Student* stud = findStudentById(studId);
+
+            if (!subj || !stud) {
+                cout << "неверный id предмета или студента\n";
+                return false;
+            }
+            uint64_t word = 0;
+            if (!subj->reserveWork(workId, stud, &word)) return false;
+
+            journalSlotState(subjId, workId, word);
+            return true;
+        }
+
+        // студент отмечает, что сдал работу
+        bool studentSubmitWork(int subjId, int studId, int workId) {
+            METRIC_TIME(Submit);
+            auto op = stateGate.enter();
+            Subject* subj = findSubjectById(subjId);
+            Student* stud = findStudentById(studId);
+
+            if (!subj || !stud) {
+                cout << "неверный id предмета или студента\n";
+                return false;
+            }
+            uint64_t word = 0;
+            if (!subj->markSubmitted(workId, stud, &word)) return false;
+
+            journalSlotState(subjId, workId, word);
+            return true;
+        }
+
+        // преподаватель утверждает работу и ставит оценку
+        bool approveWorkOnSubject(int subjId, int workId, int grade) {
+            METRIC_TIME(Approve);
+            auto op = stateGate.enter();
+            Subject* subj = findSubjectById(subjId);
+            if (!subj) {
+                cout << "предмет не найден\n";
+                return false;
+            }
+            uint64_t word = 0;
+            if (!subj->approveWork(workId, grade, &word)) return false;
+
+            journalSlotState(subjId, workId, word);
+            return true;
+        }
+
+        // преподаватель отклоняет работу
+        bool rejectWorkOnSubject(int subjId, int workId) {
+            METRIC_TIME(Reject);
+            auto op = stateGate.enter();
+            Subject* subj = findSubjectById(subjId);
+            if (!subj) {
+                cout << "предмет не найден\n";
+                return false;
+            }
+            uint64_t word = 0;
+            if (!subj->rejectWork(workId, &word)) return false;
+
+            journalSlotState(subjId, workId, word);
+            return true;
+        }
+
+        // студент спрыгивает с задания
+        bool dropWorkOnSubject(int subjId, int studId, int workId) {
+            METRIC_TIME(Drop);
+            auto op = stateGate.enter();
+            Subject* subj = findSubjectById(subjId);
+            Student* stud = findStudentById(studId);
+
+            if (!subj || !stud) {
+                cout << "неверный id предмета или студента\n";
+                return false;
+            }
+            uint64_t word = 0;
+            if (!subj->dropWork(workId, stud, &word)) return false;
+
+            journalSlotState(subjId, workId, word);
+            return true;
+        }
+
+        // импорт CSV: разбор параллельно, создание объектов одним проходом с выдачей id блоком
+        ImportResult importCsv(ImportKind kind, const string& path) {
+            METRIC_TIME(Import);
+            ImportResult result;
+            auto start = chrono::steady_clock::now();
+            auto op = stateGate.enter();
+
+            MappedFile file;
+            if (!file.open(path)) {
+                result.errors.push_back("не удалось открыть файл " + path);
+                return result;
+            }
+
+            size_t expected = kind == ImportKind::Teachers ? 1 : kind == ImportKind::Works ? 3 : 2;
+            vector<CsvChunk> chunks = parseCsvParallel(file.data, file.size, expected);
+
+            vector<const CsvRow*> rows;
+            for (const auto& chunk : chunks) {
+                for (const auto& err : chunk.errors) {
+                    result.errors.push_back("строка " + to_string(err.first) + ": " + err.second);
+                }
+                for (const auto& row : chunk.rows) rows.push_back(&row);
+            }
+            // первая строка может быть заголовком, но только целиком: студент по имени "name" - это данные
+            static const string_view headers[][3] = {
+                {"name"}, {"name", "group"}, {"teacher_id", "name"}, {"subject_id", "type", "title"}};
+            const string_view* header = headers[static_cast<int>(kind)];
+            if (!rows.empty() && rows.front()->line == 1 && equal(header, header + expected, rows.front()->fields)) {
+                rows.erase(rows.begin());
+            }
+            result.rows = rows.size() + result.errors.size(); // пока в errors только ошибки разбора
+
+            // проверяем ссылки заранее, чтобы id выдавать без дыр
+            auto parseId = [](string_view f, int& value) {
+                if (f.empty() || f.size() > 9) return false;
+                value = 0;
+                for (char ch : f) {
+                    if (ch < '0' || ch > '9') return false;
+                    value = value * 10 + (ch - '0');
+                }
+                return value > 0;
+            };
+            vector<const CsvRow*> valid;
+            vector<int> refs;
+            vector<WorkType> types;
+            valid.reserve(rows.size());
+            for (const CsvRow* row : rows) {
+                string reason;
+                int ref = 0;
+                if (kind == ImportKind::Teachers || kind == ImportKind::Students) {
+                    if (row->fields[0].empty()) reason = "пустое имя";
+                } else if (kind == ImportKind::Subjects) {
+                    if (!parseId(row->fields[0], ref) || !findTeacherById(ref)) reason = "преподаватель с таким id не найден";
+                    else if (row->fields[1].empty()) reason = "пустое название";
+                } else {
+                    string_view type = row->fields[1];
+                    if (!parseId(row->fields[0], ref) || !findSubjectById(ref)) reason = "предмет не найден";
+                    else if (type != "report" && type != "lab" && type != "0" && type != "1") reason = "неверный тип";
+                    else types.push_back(type == "report" || type == "0" ? WorkType::Report : WorkType::Lab);
+                }
+                if (!reason.empty()) {
+                    result.errors.push_back("строка " + to_string(row->line) + ": " + reason);
+                    continue;
+                }
+                valid.push_back(row);
+                refs.push_back(ref);
+            }
+
+            // id выдаём одним блоком
+            int count = static_cast<int>(valid.size());
+            int base = 0;
+            if (kind == ImportKind::Teachers || kind == ImportKind::Students) {
+                base = nextUserId.fetch_add(count);
+            } else if (kind == ImportKind::Subjects) {
+                base = nextSubjectId.fetch_add(count);
+            } else {
+                base = nextWorkId.fetch_add(count);
+            }
+
+            {
+                unique_lock<shared_mutex> lock(listsLock);
+                if (kind == ImportKind::Teachers) teachers.reserve(teachers.size() + valid.size());
+                if (kind == ImportKind::Students) students.reserve(students.size() + valid.size());
+                if (kind == ImportKind::Subjects) subjects.reserve(subjects.size() + valid.size());
+            }
+
+            string scratch[2]; // под поля с "" внутри, у студента таких может быть два
+            for (size_t i = 0; i < valid.size(); ++i) {
+                const CsvRow& row = *valid[i];
+                int id = base + static_cast<int>(i);
+                if (kind == ImportKind::Teachers) {
+                    string_view name = unquoteField(row.fields[0], scratch[0]);
+                    Teacher* t = teacherPool.create(id, strings.keep(name));
+                    BinaryWriter rec = journalRecord(JournalOp::AddTeacher);
+                    rec.putI32(id);
+                    rec.putString(name);
+                    journalAppend(rec);
+                    registerTeacher(t);
+                } else if (kind == ImportKind::Students) {
+                    string_view name = unquoteField(row.fields[0], scratch[0]);
+                    string_view group = unquoteField(row.fields[1], scratch[1]);
+                    Student* st = studentPool.create(id, strings.keep(name), strings.intern(group));
+                    BinaryWriter rec = journalRecord(JournalOp::AddStudent);
+                    rec.putI32(id);
+                    rec.putString(name);
+                    rec.putString(group);
+                    journalAppend(rec);
+                    registerStudent(st);
+                } else if (kind == ImportKind::Subjects) {
+                    string_view name = unquoteField(row.fields[1], scratch[0]);
+                    Subject* subj = subjectPool.create(id, strings.intern(name), findTeacherById(refs[i]), workPools, studentIndex, rollupFor(id));
+                    BinaryWriter rec = journalRecord(JournalOp::AddSubject);
+                    rec.putI32(id);
+                    rec.putI32(refs[i]);
+                    rec.putString(name);
+                    journalAppend(rec);
+                    registerSubject(subj);
+                } else {
+                    string_view title = unquoteField(row.fields[2], scratch[0]);
+                    Subject* subj = findSubjectById(refs[i]);
+                    auto lock = subj->writeLock();
+                    placeWork(subj, types[i], id, title);
+                    BinaryWriter rec = journalRecord(JournalOp::AddWork);
+                    rec.putI32(refs[i]);
+                    rec.putI32(id);
+                    rec.putU8(types[i] == WorkType::Report ? 0 : 1);
+                    rec.putString(title);
+                    journalAppend(rec);
+                }
+            }
+            if (!journal.commit()) result.errors.push_back("импорт не записан в журнал и пропадёт при сбое");
+
+            result.imported = valid.size();
+            result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            return result;
+        }
+
+        // ---- интерактивные обёртки для меню ----
+
+        // добавление преподавателя
+        void addTeacher() {
+            cin.ignore(numeric_limits<streamsize>::max(), '\n'); // чистим буфер
+            string name;
+            cout << "введите имя преподавателя: ";
+            getline(cin, name);
+    
+            Teacher* t = addTeacher(name);
+    
+            cout << "преподаватель добавлен, id = " << t->getId() << "\n";
+        }
+    
+        // добавление студента
+        void addStudent() {
+            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+            string name;
+            string group;
+    
+            cout << "введите имя студента: ";
+            getline(cin, name);
+            cout << "введите группу: ";
+            getline(cin, group);
+    
+            Student* s = addStudent(name, group);
+    
+            cout << "студент добавлен, id = " << s->getId() << "\n";
+        }
+    
+        // создать предмет
+        void addSubject() {
+            vector<Teacher*> known = snapshotOf(teachers);
+            if (known.empty()) {
+                cout << "сначала добавьте хотя бы одного преподавателя\n";
+                return;
+            }
+    
+            cout << "список преподавателей:\n";
+            for (auto* t : known) {
+                cout << "  id " << t->getId() << ": " << t->getName() << "\n";
+            }
+    
+            int teacherId;
+            cout << "введите id преподавателя-владельца предмета: ";
+            cin >> teacherId;
+    
+            if (!findTeacherById(teacherId)) {
+                cout << "преподаватель с таким id не найден\n";
+                return;
+            }
+    
+            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+            string name;
+            cout << "введите название предмета: ";
+            getline(cin, name);
+    
+            Subject* subj = addSubject(teacherId, name);
+            if (!subj) return;
+    
+            cout << "предмет создан, id = " << subj->getId() << "\n";
+        }
+    
+        // записать студента на предмет (просто добавляем его в список студентов предмета)
+        void enrollStudentToSubject() {
+            if (countOf(subjects) == 0 || countOf(students) == 0) {
+                cout << "нет предметов или студентов\n";
+                return;
+            }
+    
+            int subjId, studId;
+            cout << "введите id предмета: ";
+            cin >> subjId;
+            cout << "введите id студента: ";
+            cin >> studId;
+    
+            if (!findSubjectById(subjId) || !findStudentById(studId)) {
+                cout << "неверный id предмета или студента\n";
+                return;
+            }
+    
+            enrollStudentToSubject(subjId, studId);
+            cout << "студент добавлен на предмет\n";
+        }
+
+        // записать на предмет сразу всю группу
+        void enrollGroupToSubject() {
+            if (countOf(subjects) == 0 || countOf(students) == 0) {
+                cout << "нет предметов или студентов\n";
+                return;
+            }
+
+            int subjId;
+            cout << "введите id предмета: ";
+            cin >> subjId;
+
+            if (!findSubjectById(subjId)) {
+                cout << "предмет не найден\n";
+                return;
+            }
+
+            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+            string group;
+            cout << "введите группу: ";
+            getline(cin, group);
+
+            size_t added = enrollGroupToSubject(subjId, group);
+            cout << "из группы " << group << " на предмет добавлено студентов: " << added << "\n";
+        }
+    
+        // добавить задание на предмет (доклад/лаба)
+        void addWorkToSubject() {
+            if (countOf(subjects) == 0) {
+                cout << "нет предметов\n";
+                return;
+            }
+    
+            int subjId;
+            cout << "введите id предмета: ";
+            cin >> subjId;
+    
+            if (!findSubjectById(subjId)) {
+                cout << "предмет не найден\n";
+                return;
+            }
+    
+            int typeInt;
+            cout << "выберите тип задания (0 - доклад, 1 - лаба): ";
+            cin >> typeInt;
+    
+            if (typeInt != 0 && typeInt != 1) {
+                cout << "неверный тип\n";
+                return;
+            }
+    
+            WorkType type = (typeInt == 0) ? WorkType::Report : WorkType::Lab;
+    
+            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+            string title;
+            cout << "введите название задания: ";
+            getline(cin, title);
+    
+            addWorkToSubject(subjId, type, title);
+    
+            cout << "задание добавлено на предмет\n";
+        }
+    
+        // студент записывается на конкретное задание
+        void reserveWorkOnSubject() {
+            int subjId, studId, workId;
+            cout << "введите id предмета: ";
+            cin >> subjId;
+            cout << "введите id студента: ";
+            cin >> studId;
+            cout << "введите id задания: ";
+            cin >> workId;
+    
+            reserveWorkOnSubject(subjId, studId, workId);
+        }
+    
+        // студент отмечает, что сдал работу
+        void studentSubmitWork() {
+            int subjId, studId, workId;
+            cout << "введите id предмета: ";
+            cin >> subjId;
+            cout << "введите id студента: ";
+            cin >> studId;
+            cout << "введите id задания: ";
+            cin >> workId;
+    
+            studentSubmitWork(subjId, studId, workId);
+        }
+    
+        // преподаватель утверждает работу и ставит оценку
+        void approveWorkOnSubject() {
+            int subjId, workId, grade;
+            cout << "введите id предмета: ";
+            cin >> subjId;
+            cout << "введите id задания: ";
+            cin >> workId;
+            cout << "введите оценку: ";
+            cin >> grade;
+    
+            approveWorkOnSubject(subjId, workId, grade);
+        }
+    
+        // преподаватель отклоняет работу
+        void rejectWorkOnSubject() {
+            int subjId, workId;
+            cout << "введите id предмета: ";
+            cin >> subjId;
+            cout << "введите id задания: ";
+            cin >> workId;
+    
+            rejectWorkOnSubject(subjId, workId);
+        }
+    
+        // студент спрыгивает с задания
+        void dropWorkOnSubject() {
+            int subjId, studId, workId;
+            cout << "введите id предмета: ";
+            cin >> subjId;
+            cout << "введите id студента: ";
+            cin >> studId;
+            cout << "введите id задания: ";
+            cin >> workId;
+    
+            dropWorkOnSubject(subjId, studId, workId);
+        }
+    
+        // импорт из CSV
+        void importCsvMenu() {
+            int kindInt;
+            cout << "что импортируем (0 - преподаватели, 1 - студенты, 2 - предметы, 3 - задания): ";
+            cin >> kindInt;
+            if (kindInt < 0 || kindInt > 3) {
+                cout << "неверный тип\n";
+                return;
+            }
+
+            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+            string path;
+            cout << "введите путь к CSV файлу: ";
+            getline(cin, path);
+
+            printImportResult(importCsv(static_cast<ImportKind>(kindInt), path));
+        }
+
+        // итог импорта: первые ошибки и скорость
+        static void printImportResult(const ImportResult& r) {
+            const size_t shown = 20;
+            for (size_t i = 0; i < r.errors.size() && i < shown; ++i) {
+                cout << "  " << r.errors[i] << "\n";
+            }
+            if (r.errors.size() > shown) {
+                cout << "  ... и ещё ошибок: " << r.errors.size() - shown << "\n";
+            }
+            cout << "импортировано " << r.imported << " из " << r.rows << " строк, отклонено "
+                 << r.errors.size() << ", время " << static_cast<long long>(r.seconds * 1000) << " мс";
+            if (r.seconds > 0) {
+                cout << ", " << static_cast<long long>(r.rows / r.seconds) << " строк/с";
+            }
+            cout << "\n";
+        }
+    
+        // статистика пулов объектов
+        void showMemoryStats() const {
+            size_t totalBytes = 0;
+            auto row = [&totalBytes](const char* title, size_t objects, size_t blocks, size_t bytes) {
+                cout << "  " << title << ": объектов " << objects << ", блоков " << blocks
+                     << ", зарезервировано " << bytes / 1024 << " КБ\n";
+                totalBytes += bytes;
+            };
+            cout << "пулы объектов:\n";
+            row("студенты", studentPool.size(), studentPool.blockCount(), studentPool.bytesReserved());
+            row("преподаватели", teacherPool.size(), teacherPool.blockCount(), teacherPool.bytesReserved());
+            row("предметы", subjectPool.size(), subjectPool.blockCount(), subjectPool.bytesReserved());
+            row("доклады", workPools.reports.size(), workPools.reports.blockCount(), workPools.reports.bytesReserved());
+            row("лабы", workPools.labs.size(), workPools.labs.blockCount(), workPools.labs.bytesReserved());
+            cout << "  всего зарезервировано: " << totalBytes / 1024 << " КБ\n";
+            showStringStats();
+            if (searchStale.load(memory_order_acquire)) cout << "поисковый индекс: будет построен при первом поиске\n";
+            else searchIndex.printReport();
+        }
+
+        // сколько места сберёг пул строк против отдельных std::string
+        void showStringStats() const {
+            strings.printReport();
+        }
+
+        // ---- статистика по оценкам и статусам ----
+
+        static SlotStats subjectStats(const Subject& s) {
+            SlotStats st;
+            s.forEachStateRun([&st](const uint64_t* words, size_t n) { statkernels::accumulate(words, n, st); });
+            return st;
+        }
+
+        SlotStats universityStats() const {
+            SlotStats total;
+            for (auto* s : snapshotOf(subjects)) total.merge(subjectStats(*s));
+            return total;
+        }
+
+        // по группе: слоты её студентов берём из их обратных индексов, O(работ группы),
+        // складываем в плотный столбец и гоним через те же ядра
+        SlotStats groupStats(const string& group) const {
+            vector<uint64_t> words;
+            for (auto* member : groupMembers(group)) collectStudentSlots(member, words);
+            SlotStats st;
+            statkernels::accumulate(words.data(), words.size(), st);
+            return st;
+        }
+
+        // наивный подсчёт через список слотов - для сверки и сравнения скорости
+        static SlotStats naiveSubjectStats(const Subject& s) {
+            SlotStats st;
+            auto lock = s.readLock();
+            for (const AssignmentSlot& slot : s.getAssignmentsList()) {
+                if (!slot.reservedBy) {
+                    ++st.freeSlots;
+                } else if (!slot.submitted) {
+                    ++st.reserved;
+                } else if (!slot.approved) {
+                    ++st.submitted;
+                } else {
+                    ++st.approved;
+                    st.gradeSum += slot.grade;
+                    if (slot.grade >= 0 && slot.grade < GRADE_BUCKETS) ++st.histogram[slot.grade];
+                    else st.outliers.push_back(slot.grade);
+                }
+            }
+            return st;
+        }
+
+        static void printStats(const string& title, const SlotStats& st) {
+            cout << "статистика: " << title << "\n";
+            cout << "  слотов: " << st.total() << " (свободно " << st.freeSlots << ", записано " << st.reserved
+                 << ", сдано " << st.submitted << ", утверждено " << st.approved << ")\n";
+            if (st.approved == 0) {
+                cout << "  оценок пока нет\n";
+                return;
+            }
+            cout << "  оценки: среднее " << st.mean() << ", медиана " << st.median() << "\n";
+            cout << "  гистограмма:";
+            for (int g = 0; g < GRADE_BUCKETS; ++g) {
+                if (st.histogram[g]) cout << " " << g << ":" << st.histogram[g];
+            }
+            if (!st.outliers.empty()) cout << " другие:" << st.outliers.size();
+            cout << "\n";
+        }
+
+        bool showSubjectStats(int subjId) const {
+            METRIC_TIME(Stats);
+            Subject* s = findSubjectById(subjId);
+            if (!s) {
+                cout << "предмет не найден\n";
+                return false;
+            }
+            printStats("предмет \"" + string(s->getName()) + "\"", subjectStats(*s));
+            return true;
+        }
+
+        void showGroupStats(const string& group) const {
+            METRIC_TIME(Stats);
+            printStats("группа " + group, groupStats(group));
+        }
+
+        void showUniversityStats() const {
+            METRIC_TIME(Stats);
+            printStats("весь университет", universityStats());
+        }
+
+        // ---- сводки по счётчикам: O(1) на предмет, без обхода слотов ----
+
+        SlotSummary universitySummary() const {
+            SlotSummary total;
+            for (const auto& stripe : rollup) {
+                SlotSummary part = stripe.load();
+                total.freeSlots += part.freeSlots;
+                total.reserved += part.reserved;
+                total.submitted += part.submitted;
+                total.approved += part.approved;
+                total.gradeSum += part.gradeSum;
+            }
+            return total;
+        }
+
+        static void printSummary(const string& title, const SlotSummary& s) {
+            cout << title << ": слотов " << s.total() << " (свободно " << s.freeSlots << ", записано " << s.reserved
+                 << ", сдано " << s.submitted << ", утверждено " << s.approved << ")";
+            if (s.approved) cout << ", средняя " << s.mean();
+            cout << "\n";
+        }
+
+        bool showSubjectSummary(int subjId) const {
+            METRIC_TIME(Stats);
+            Subject* s = findSubjectById(subjId);
+            if (!s) {
+                cout << "предмет не найден\n";
+                return false;
+            }
+            printSummary("предмет #" + to_string(s->getId()) + " \"" + string(s->getName()) + "\"", s->summary());
+            return true;
+        }
+
+        // строка на предмет и итог по университету - для панелей, которые опрашивают часто
+        void showSummary() const {
+            METRIC_TIME(Stats);
+            for (auto* s : snapshotOf(subjects)) {
+                printSummary("предмет #" + to_string(s->getId()) + " \"" + string(s->getName()) + "\"", s->summary());
+            }
+            printSummary("весь университет", universitySummary());
+        }
+
+        // отладочная сверка счётчиков с полным обходом слотов; операции на это время стоят
+        bool verifyCounters(bool verbose = true) const {
+            auto quiet = stateGate.quiesce();
+            auto asSummary = [](const SlotStats& st) {
+                SlotSummary s;
+                s.freeSlots = static_cast<long long>(st.freeSlots);
+                s.reserved = static_cast<long long>(st.reserved);
+                s.submitted = static_cast<long long>(st.submitted);
+                s.approved = static_cast<long long>(st.approved);
+                s.gradeSum = st.gradeSum;
+                return s;
+            };
+            size_t mismatches = 0;
+            vector<Subject*> all = snapshotOf(subjects);
+            for (auto* s : all) {
+                SlotSummary scanned = asSummary(subjectStats(*s));
+                if (scanned == s->summary()) continue;
+                ++mismatches;
+                cout << "счётчики предмета #" << s->getId() << " разошлись с обходом:\n";
+                printSummary("  счётчики", s->summary());
+                printSummary("  обход", scanned);
+            }
+            SlotSummary scanned = asSummary(universityStats());
+            if (scanned != universitySummary()) {
+                ++mismatches;
+                cout << "общая сводка разошлась с обходом:\n";
+                printSummary("  счётчики", universitySummary());
+                printSummary("  обход", scanned);
+            }
+            if (verbose || mismatches) {
+                cout << "сверка счётчиков: предметов " << all.size() << ", расхождений " << mismatches << "\n";
+            }
+            return mismatches == 0;
+        }
+
+        // сравнить векторные ядра с наивным обходом на текущих данных
+        void benchmarkStats(int reps) const {
+            if (reps <= 0) reps = 1;
+            vector<Subject*> all = snapshotOf(subjects);
+            size_t slots = 0;
+            for (auto* s : all) {
+                auto lock = s->readLock();
+                slots += s->slotCount();
+            }
+
+            auto timeIt = [&](auto&& fn) {
+                auto start = chrono::steady_clock::now();
+                SlotStats last;
+                for (int r = 0; r < reps; ++r) {
+                    last = SlotStats();
+                    for (auto* s : all) last.merge(fn(*s));
+                }
+                double sec = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+                return make_pair(sec, last);
+            };
+            auto naive = timeIt(naiveSubjectStats);
+            auto fast = timeIt(subjectStats);
+
+            bool same = naive.second.freeSlots == fast.second.freeSlots && naive.second.reserved == fast.second.reserved &&
+                        naive.second.submitted == fast.second.submitted && naive.second.approved == fast.second.approved &&
+                        naive.second.gradeSum == fast.second.gradeSum &&
+                        naive.second.outliers.size() == fast.second.outliers.size() &&
+                        equal(begin(naive.second.histogram), end(naive.second.histogram), begin(fast.second.histogram));
+            cout << "бенчмарк статистики: слотов " << slots << ", повторов " << reps << ", ядро " << statkernels::name() << "\n";
+            cout << "  наивно: " << naive.first * 1000 / reps << " мс за проход\n";
+            cout << "  ядро:   " << fast.first * 1000 / reps << " мс за проход";
+            if (fast.first > 0) cout << " (в " << naive.first / fast.first << " раз быстрее)";
+            cout << "\n  результаты " << (same ? "совпадают" : "НЕ совпадают") << "\n";
+        }
+
+        void statsMenu() const {
+            int mode = 0;
+            cout << "статистика (0 - по предмету, 1 - по группе, 2 - по всему университету): ";
+            if (!(cin >> mode)) {
+                cin.clear();
+                cin.ignore(numeric_limits<streamsize>::max(), '\n');
+                cout << "неверный ввод\n";
+                return;
+            }
+            if (mode == 0) {
+                int subjId;
+                cout << "введите id предмета: ";
+                cin >> subjId;
+                showSubjectStats(subjId);
+            } else if (mode == 1) {
+                cin.ignore(numeric_limits<streamsize>::max(), '\n');
+                string group;
+                cout << "введите группу: ";
+                getline(cin, group);
+                showGroupStats(group);
+            } else if (mode == 2) {
+                showUniversityStats();
+            } else {
+                cout << "нет такого пункта\n";
+            }
+        }
+
+        // вывести список предметов (кратко)
+        void listSubjects() const {
+            vector<Subject*> all = snapshotOf(subjects);
+            if (all.empty()) {
+                cout << "нет предметов\n";
+                return;
+            }
+    
+            cout << "список предметов:\n";
+            for (auto* s : all) {
+                s->printShort();
+            }
+        }
+
+        // вывести список всех студентов
+        void listStudents() const {
+            vector<Student*> all = snapshotOf(students);
+            if (all.empty()) {
+                cout << "студентов нет\n";
+                return;
+            }
+            cout << "список студентов:\n";
+            for (auto* s : all) {
+                cout << "  id " << s->getId()
+                     << ": " << s->getName()
+                     << " (группа: " << s->getGroup() << ")\n";
+            }
+        }
+
+        // вывести список всех преподавателей
+        void listTeachers() const {
+            vector<Teacher*> all = snapshotOf(teachers);
+            if (all.empty()) {
+                cout << "преподавателей нет\n";
+                return;
+            }
+            cout << "список преподавателей:\n";
+            for (auto* t : all) {
+                cout << "  id " << t->getId()
+                     << ": " << t->getName()
+                     << " (роль: " << userRoleName(UserRole::Teacher) << ")\n";
+            }
+        }
+
+        // вывести преподавателей по предметам
+        void listTeachersBySubjects() const {
+            vector<Subject*> all = snapshotOf(subjects);
+            if (all.empty()) {
+                cout << "нет предметов\n";
+                return;
+            }
+            cout << "преподаватели по предметам:\n";
+            for (auto* sub : all) {
+                cout << "  предмет #" << sub->getId()
+                     << " \"" << sub->getName() << "\"";
+                if (sub->getOwner()) {
+                    cout << " → " << sub->getOwner()->getName();
+                } else {
+                    cout << " → (нет преподавателя)";
+                }
+                cout << "\n";
+            }
+        }
+
+        // поиск по подстроке (или по началу слова) в именах, группах и названиях
+        size_t search(string_view query, bool prefix, size_t limit = SEARCH_LIMIT) const {
+            METRIC_TIME(Search);
+            ensureSearchIndex();
+            vector<SearchIndex::Hit> hits;
+            searchIndex.find(query, prefix, limit + 1, hits);
+            bool more = hits.size() > limit;
+            if (more) hits.pop_back();
+            if (hits.empty()) {
+                cout << "ничего не найдено\n";
+                return 0;
+            }
+
+            cout << "найдено: " << hits.size() << (more ? " (показаны первые, есть ещё)" : "") << "\n";
+            for (const auto& hit : hits) {
+                if (hit.kind == SearchKind::Student) {
+                    if (Student* st = findStudentById(hit.id)) {
+                        cout << "  студент id " << st->getId() << ": " << st->getName() << " (группа: " << st->getGroup() << ")\n";
+                    }
+                } else if (hit.kind == SearchKind::Teacher) {
+                    if (Teacher* t = findTeacherById(hit.id)) {
+                        cout << "  препод id " << t->getId() << ": " << t->getName() << "\n";
+                    }
+                } else if (hit.kind == SearchKind::Subject) {
+                    if (Subject* subj = findSubjectById(hit.id)) {
+                        cout << "  предмет #" << subj->getId() << " \"" << subj->getName() << "\"\n";
+                    }
+                } else if (Subject* subj = findSubjectById(hit.parent)) {
+                    auto lock = subj->readLock();
+                    if (const Work* w = subj->findWork(hit.id)) {
+                        cout << "  " << workTypeName(w->getType()) << " #" << w->getId() << " \"" << w->getTitle()
+                             << "\" на предмете #" << subj->getId() << " \"" << subj->getName() << "\"\n";
+                    }
+                }
+            }
+            return hits.size();
+        }
+
+        void searchMenu() const {
+            int mode = 0;
+            cout << "искать (0 - подстроку, 1 - начало слова): ";
+            if (!(cin >> mode)) {
+                cin.clear();
+                cin.ignore(numeric_limits<streamsize>::max(), '\n');
+                cout << "неверный ввод\n";
+                return;
+            }
+            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+            string query;
+            cout << "введите текст: ";
+            getline(cin, query);
+            search(query, mode == 1);
+        }
+
+        // показать активность студента по всем предметам
+        void showStudentActivity() const {
+            if (countOf(students) == 0) {
+                cout << "нет студентов\n";
+                return;
+            }
+
+            int studId;
+            cout << "введите id студента: ";
+            cin >> studId;
+
+            showStudentActivity(studId);
+        }
+
+        // активность студента по id, false если такого студента нет
+        bool showStudentActivity(int studId) const {
+            METRIC_TIME(ShowActivity);
+            Student* stud = findStudentById(studId);
+
+            if (!stud) {
+                cout << "студент не найден\n";
+                return false;
+            }
+
+            cout << "\n=== активность студента: " << stud->getName() << " ===\n";
+
+            bool foundAny = false;
+
+            // раскладываем слоты студента по предметам, O(число его работ)
+            unordered_map<const Subject*, vector<size_t>> slotsBySubject;
+            for (const WorkRef& ref : stud->getWorks()) {
+                slotsBySubject[ref.subject].push_back(ref.slot);
+            }
+
+            // предметы выводим в порядке создания, как в общем списке
+            vector<Subject*> enrolled = stud->getEnrolledSubjects();
+            sort(enrolled.begin(), enrolled.end(),
+                 [](const Subject* a, const Subject* b) { return a->getId() < b->getId(); });
+
+            for (auto* subj : enrolled) {
+                cout << "\nпредмет: " << subj->getName() << "\n";
+
+                auto it = slotsBySubject.find(subj);
+                if (it == slotsBySubject.end()) continue;
+
+                vector<size_t>& slots = it->second;
+                sort(slots.begin(), slots.end());
+
+                auto lock = subj->readLock();
+                for (size_t idx : slots) {
+                    const AssignmentSlot slot = subj->slotAt(idx);
+                    // пока копировали индекс, слот могли успеть освободить
+                    if (slot.work == nullptr || slot.reservedBy != stud) continue;
+
+                    foundAny = true;
+
+                    cout << " - " << workTypeName(slot.type)
+                         << " \"" << slot.work->getTitle() << "\"";
+
+                    if (!slot.submitted && !slot.approved) {
+                        cout << " → записан, ещё не сдал\n";
+                    } else if (slot.submitted && !slot.approved) {
+                        cout << " → сдано, ожидает проверки\n";
+                    } else if (slot.approved) {
+                        cout << " → оценка: " << slot.grade << "\n";
+                    } else {
+                        cout << "\n";
+                    }
+                }
+            }
+
+            if (!foundAny) {
+                cout << "у студента нет активных работ\n";
+            }
+            return true;
+        }
+
+        // активность группы: строка на студента и итог по оценкам, O(работ группы)
+        bool showGroupActivity(const string& group) const {
+            METRIC_TIME(ShowActivity);
+            vector<Student*> members = groupMembers(group);
+            if (members.empty()) {
+                cout << "в группе " << group << " нет студентов\n";
+                return false;
+            }
+
+            cout << "\n=== группа " << group << ": студентов " << members.size() << " ===\n";
+            SlotStats total;
+            vector<uint64_t> words;
+            for (auto* st : members) {
+                words.clear();
+                collectStudentSlots(st, words);
+                SlotStats own;
+                statkernels::accumulate(words.data(), words.size(), own);
+                total.merge(own);
+
+                cout << "  id " << st->getId() << ": " << st->getName()
+                     << " - предметов " << st->getEnrolledSubjects().size()
+                     << ", записан " << own.reserved << ", сдано " << own.submitted
+                     << ", утверждено " << own.approved;
+                if (own.approved) cout << ", средняя " << own.mean();
+                cout << "\n";
+            }
+            printStats("группа " + group, total);
+            return true;
+        }
+
+        // все группы с числом студентов и средней оценкой, по алфавиту
+        void listGroups() const {
+            vector<vector<Student*>> all;
+            {
+                shared_lock<shared_mutex> lock(listsLock);
+                all.reserve(groupIndex.size());
+                for (const auto& entry : groupIndex) all.push_back(entry.second);
+            }
+            if (all.empty()) {
+                cout << "групп нет\n";
+                return;
+            }
+            sort(all.begin(), all.end(), [](const vector<Student*>& a, const vector<Student*>& b) {
+                return a.front()->getGroup() < b.front()->getGroup();
+            });
+
+            cout << "группы (" << all.size() << "):\n";
+            vector<uint64_t> words;
+            for (const auto& members : all) {
+                words.clear();
+                for (auto* st : members) collectStudentSlots(st, words);
+                SlotStats st;
+                statkernels::accumulate(words.data(), words.size(), st);
+                cout << "  " << members.front()->getGroup() << ": студентов " << members.size()
+                     << ", утверждено " << st.approved;
+                if (st.approved) cout << ", средняя " << st.mean();
+                cout << "\n";
+            }
+        }
+
+        // групповые запросы из меню
+        void showGroupActivity() const {
+            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+            string group;
+            cout << "введите группу: ";
+            getline(cin, group);
+            showGroupActivity(group);
+        }
+    
+        // показать подробную инфу по одному предмету
+        void showSubjectDetails() const {
             int subjId;
             cout << "введите id предмета: ";
             cin >> subjId;
     
-            Subject* subj = findSubjectById(subjId);
-            if (!subj) {
+            showSubjectDetails(subjId);
+        }
+
+        bool showSubjectDetails(int subjId) const {
+            METRIC_TIME(ShowSubject);
+            Subject* s = findSubjectById(subjId);
+            if (!s) {
+                cout << "предмет не найден\n";
+                return false;
+            }
+            auto lock = s->readLock();
+            s->printFull();
+            return true;
+        }
+    
+        //выгрузка итогов
+        void exportSubjectReport() const {
+            int subjId;
+            cout << "введите id предмета для отчёта: ";
+            cin >> subjId;
+
+            ReportFormat format;
+            if (!askReportFormat(format)) return;
+
+            exportSubjectReport(subjId, format);
+        }
+
+        static bool askReportFormat(ReportFormat& format) {
+            int formatInt = 0;
+            cout << "формат отчёта (0 - текст, 1 - csv, 2 - json): ";
+            if (!(cin >> formatInt)) {
+                cin.clear();
+                cin.ignore(numeric_limits<streamsize>::max(), '\n');
+                cout << "неверный ввод\n";
+                return false;
+            }
+            if (formatInt < 0 || formatInt > 2) {
+                cout << "неверный формат\n";
+                return false;
+            }
+            format = static_cast<ReportFormat>(formatInt);
+            return true;
+        }
+
+        // force - перезаписать файл, даже если предмет не менялся с прошлой выгрузки
+        bool exportSubjectReport(int subjId, ReportFormat format = ReportFormat::Text, bool force = false) const {
+            METRIC_TIME(Export);
+            Subject* s = findSubjectById(subjId);
+            if (!s) {
                 cout << "предмет не найден\n";
+                return false;
+            }
+
+            // Показываем отчёт в консоли
+            echoSubjectReport(*s);
+
+            string filename = reportFileName(subjId, format);
+            uint64_t version = s->getVersion();
+            if (!force && reportUpToDate(subjId, format, version)) {
+                cout << "предмет не менялся, файл актуален: " << filename << "\n";
+                return true;
+            }
+            string text;
+            formatSubjectReport(*s, text, format);
+            struct stat written;
+            if (!writeWholeFile(filename, text, &written)) {
+                cout << "ошибка: не удалось открыть файл для записи\n";
+                return false;
+            }
+            noteExported(subjId, format, version, written);
+
+            cout << "отчёт сохранён в файл: " << filename << "\n";
+            return true;
+        }
+
+        static string reportFileName(int subjId, ReportFormat format) {
+            return "report_subject_" + to_string(subjId) + reportExtension(format);
+        }
+
+        static uint64_t manifestKey(int subjId, ReportFormat format) {
+            return static_cast<uint64_t>(subjId) << 8 | static_cast<uint64_t>(format);
+        }
+        static bool sameTime(const timespec& a, const timespec& b) {
+            return a.tv_sec == b.tv_sec && a.tv_nsec == b.tv_nsec;
+        }
+        // файл отчёта актуален: выгружен с этой же версии предмета и с тех пор не тронут
+        // (тот же inode, размер и времена изменения - правка с тем же размером тоже заметна)
+        bool reportUpToDate(int subjId, ReportFormat format, uint64_t version) const {
+            ExportedReport known;
+            {
+                lock_guard<mutex> lock(manifestLock);
+                auto it = exportManifest.find(manifestKey(subjId, format));
+                if (it == exportManifest.end()) return false;
+                known = it->second;
+            }
+            if (known.version != version) return false;
+            struct stat info;
+            return stat(reportFileName(subjId, format).c_str(), &info) == 0 &&
+                   static_cast<size_t>(info.st_size) == known.bytes && info.st_ino == known.inode &&
+                   sameTime(info.st_mtim, known.modified) && sameTime(info.st_ctim, known.changed);
+        }
+        // версию берём до сборки текста: изменение во время сборки просто оставит предмет грязным
+        void noteExported(int subjId, ReportFormat format, uint64_t version, const struct stat& written) const {
+            lock_guard<mutex> lock(manifestLock);
+            exportManifest[manifestKey(subjId, format)] = {version, static_cast<size_t>(written.st_size), written.st_ino,
+                                                           written.st_mtim, written.st_ctim};
+        }
+
+        static void echoSubjectReport(const Subject& s) {
+            cout << "==== отчёт по предмету \"" << s.getName() << "\" ====\n";
+            auto lock = s.readLock();
+            s.printFull();
+            cout << "==== конец отчёта ====\n";
+        }
+
+        // отчёт собираем в один буфер, чтобы отдать файлу одним write
+        static void formatSubjectReport(const Subject& s, string& out, ReportFormat format) {
+            out.clear();
+            auto lock = s.readLock();
+            if (format == ReportFormat::Csv) {
+                formatCsvReport(s, out);
+            } else if (format == ReportFormat::Json) {
+                formatJsonReport(s, out);
+            } else {
+                formatTextReport(s, out);
+            }
+        }
+
+        static void formatTextReport(const Subject& s, string& out) {
+            out += "ОТЧЁТ ПО ПРЕДМЕТУ\n";
+            out += "Название: ";
+            out += s.getName();
+            out += "\nID предмета: ";
+            appendInt(out, s.getId());
+            out += "\n";
+
+            if (s.getOwner()) {
+                out += "Преподаватель: ";
+                out += s.getOwner()->getName();
+                out += "\n";
+            }
+
+            out += "----------------------------------------\n";
+
+            // Студенты
+            out += "\nСтуденты (";
+            appendInt(out, static_cast<long long>(s.getStudentsList().size()));
+            out += "):\n";
+            for (auto* st : s.getStudentsList()) {
+                if (!st) continue;
+                out += " - ";
+                out += st->getName();
+                out += " (группа: ";
+                out += st->getGroup();
+                out += ")\n";
+            }
+
+            // Задания
+            out += "\nЗадания:\n";
+            for (size_t i = 0; i < s.slotCount(); ++i) {
+                const AssignmentSlot slot = s.slotAt(i);
+                if (!slot.work) continue;
+
+                out += " * ";
+                out += workTypeName(slot.type);
+                out += " \"";
+                out += slot.work->getTitle();
+                out += "\"";
+
+                if (!slot.reservedBy) {
+                    out += " → свободно\n";
+                } else {
+                    out += " → студент: ";
+                    out += slot.reservedBy->getName();
+
+                    if (!slot.submitted && !slot.approved) {
+                        out += " | статус: записан\n";
+                    } else if (slot.submitted && !slot.approved) {
+                        out += " | статус: сдано, ждёт проверки\n";
+                    } else if (slot.approved) {
+                        out += " | оценка: ";
+                        appendInt(out, slot.grade);
+                        out += "\n";
+                    }
+                }
+            }
+
+            out += "\n--- конец отчёта ---\n";
+        }
+
+        // CSV: одна таблица, тип записи в первой колонке (subject / student / slot)
+        static void formatCsvReport(const Subject& s, string& out) {
+            const Teacher* owner = s.getOwner();
+            out += "record,subject_id,subject_name,owner_id,owner_name,student_id,student_name,group,"
+                   "work_id,work_type,title,reserved_by,submitted,approved,grade\n";
+
+            out += "subject,";
+            appendInt(out, s.getId());
+            out += ',';
+            appendCsvField(out, s.getName());
+            out += ',';
+            if (owner) {
+                appendInt(out, owner->getId());
+                out += ',';
+                appendCsvField(out, owner->getName());
+            } else {
+                out += ',';
+            }
+            out += ",,,,,,,,,,\n";
+
+            for (const Student* st : s.getStudentsList()) {
+                out += "student,";
+                appendInt(out, s.getId());
+                out += ",,,,";
+                appendInt(out, st->getId());
+                out += ',';
+                appendCsvField(out, st->getName());
+                out += ',';
+                appendCsvField(out, st->getGroup());
+                out += ",,,,,,,\n";
+            }
+
+            for (size_t i = 0; i < s.slotCount(); ++i) {
+                const AssignmentSlot slot = s.slotAt(i);
+                if (!slot.work) continue;
+                out += "slot,";
+                appendInt(out, s.getId());
+                out += ",,,,,,,";
+                appendInt(out, slot.work->getId());
+                out += ',';
+                out += workTypeCode(slot.type);
+                out += ',';
+                appendCsvField(out, slot.work->getTitle());
+                out += ',';
+                if (slot.reservedBy) appendInt(out, slot.reservedBy->getId());
+                out += slot.submitted ? ",1" : ",0";
+                out += slot.approved ? ",1," : ",0,";
+                if (slot.approved) appendInt(out, slot.grade);
+                out += '\n';
+            }
+        }
+
+        static void formatJsonReport(const Subject& s, string& out) {
+            const Teacher* owner = s.getOwner();
+            out += "{\"subject_id\":";
+            appendInt(out, s.getId());
+            out += ",\"name\":";
+            appendJsonString(out, s.getName());
+            out += ",\"owner\":";
+            if (owner) {
+                out += "{\"id\":";
+                appendInt(out, owner->getId());
+                out += ",\"name\":";
+                appendJsonString(out, owner->getName());
+                out += '}';
+            } else {
+                out += "null";
+            }
+
+            out += ",\"students\":[";
+            bool first = true;
+            for (const Student* st : s.getStudentsList()) {
+                if (!first) out += ',';
+                first = false;
+                out += "{\"id\":";
+                appendInt(out, st->getId());
+                out += ",\"name\":";
+                appendJsonString(out, st->getName());
+                out += ",\"group\":";
+                appendJsonString(out, st->getGroup());
+                out += '}';
+            }
+
+            out += "],\"slots\":[";
+            first = true;
+            for (size_t i = 0; i < s.slotCount(); ++i) {
+                const AssignmentSlot slot = s.slotAt(i);
+                if (!slot.work) continue;
+                if (!first) out += ',';
+                first = false;
+                out += "{\"work_id\":";
+                appendInt(out, slot.work->getId());
+                out += ",\"type\":\"";
+                out += workTypeCode(slot.type);
+                out += '"';
+                out += ",\"title\":";
+                appendJsonString(out, slot.work->getTitle());
+                out += ",\"reserved_by\":";
+                if (slot.reservedBy) appendInt(out, slot.reservedBy->getId());
+                else out += "null";
+                out += slot.submitted ? ",\"submitted\":true" : ",\"submitted\":false";
+                out += slot.approved ? ",\"approved\":true" : ",\"approved\":false";
+                out += ",\"grade\":";
+                if (slot.approved) appendInt(out, slot.grade);
+                else out += "null";
+                out += '}';
+            }
+            out += "]}\n";
+        }
+
+        // записать буфер в файл целиком; written - что получилось на диске (для манифеста выгрузки)
+        static bool writeWholeFile(const string& path, const string& data, struct stat* written = nullptr) {
+            int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (fd < 0) return false;
+            const char* p = data.data();
+            size_t len = data.size();
+            while (len > 0) {
+                ssize_t n = ::write(fd, p, len);
+                if (n < 0 && errno == EINTR) continue; // сигнал остановки не должен срывать выгрузку
+                if (n < 0) {
+                    ::close(fd);
+                    return false;
+                }
+                p += n;
+                len -= static_cast<size_t>(n);
+            }
+            bool ok = !written || fstat(fd, written) == 0;
+            return ::close(fd) == 0 && ok;
+        }
+
+        // заменить файл так, чтобы после сбоя питания на диске был либо старый, либо новый целиком:
+        // временный файл -> fsync -> rename -> fsync каталога
+        static bool replaceFileDurably(const string& path, const string& data) {
+            string tmp = path + ".tmp";
+            int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if (fd < 0) return false;
+            const char* p = data.data();
+            size_t len = data.size();
+            while (len > 0) {
+                ssize_t n = ::write(fd, p, len);
+                if (n < 0 && errno == EINTR) continue;
+                if (n < 0) break;
+                p += n;
+                len -= static_cast<size_t>(n);
+            }
+            bool ok = len == 0 && fsync(fd) == 0;
+            if (::close(fd) != 0) ok = false;
+            if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+                unlink(tmp.c_str());
+                return false;
+            }
+            // без fsync каталога сама замена имени может не пережить сбой
+            size_t slash = path.rfind('/');
+            string dir = slash == string::npos ? "." : (slash == 0 ? "/" : path.substr(0, slash));
+            int dirFd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            if (dirFd < 0) return false;
+            ok = fsync(dirFd) == 0;
+            ::close(dirFd);
+            return ok;
+        }
+
+        // выгрузить отчёты по всем предметам; файлы пишет пул потоков, консоль - по желанию
+        // возвращает, сколько отчётов на диске актуальны: перезаписанные плюс нетронутые
+        size_t exportAllReports(bool echo, ReportFormat format = ReportFormat::Text, bool force = false) const {
+            METRIC_TIME(ExportAll);
+            vector<Subject*> all = snapshotOf(subjects);
+            if (all.empty()) {
+                cout << "нет предметов\n";
+                return 0;
+            }
+            auto start = chrono::steady_clock::now();
+
+            if (echo) {
+                for (auto* s : all) echoSubjectReport(*s);
+            }
+
+            // грязные - те, чья версия разошлась с манифестом; только их и пишем
+            vector<pair<Subject*, uint64_t>> dirty;
+            dirty.reserve(all.size());
+            for (auto* s : all) {
+                uint64_t version = s->getVersion();
+                if (force || !reportUpToDate(s->getId(), format, version)) dirty.emplace_back(s, version);
+            }
+
+            atomic<size_t> next{0};
+            atomic<size_t> failed{0};
+            auto worker = [&]() {
+                string text;
+                text.reserve(1 << 16);
+                for (size_t i = next++; i < dirty.size(); i = next++) {
+                    const Subject& s = *dirty[i].first;
+                    formatSubjectReport(s, text, format);
+                    struct stat written;
+                    if (writeWholeFile(reportFileName(s.getId(), format), text, &written)) {
+                        noteExported(s.getId(), format, dirty[i].second, written);
+                    } else {
+                        ++failed;
+                    }
+                }
+            };
+
+            size_t workers = max<size_t>(1, min<size_t>(thread::hardware_concurrency(), dirty.size()));
+            vector<thread> pool;
+            for (size_t i = 1; i < workers; ++i) pool.emplace_back(worker);
+            worker();
+            for (auto& t : pool) t.join();
+
+            double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            size_t written = dirty.size() - failed;
+            cout << "выгружено отчётов: " << written << " из " << all.size()
+                 << ", без изменений " << all.size() - dirty.size()
+                 << ", потоков " << workers << ", время " << static_cast<long long>(seconds * 1000) << " мс\n";
+            if (failed > 0) {
+                cout << "ошибка: не удалось записать отчётов: " << failed << "\n";
+            }
+            return all.size() - failed;
+        }
+
+        void exportAllReportsMenu() const {
+            ReportFormat format;
+            if (!askReportFormat(format)) return;
+
+            int echo = 0;
+            cout << "показывать отчёты в консоли? (1 - да, 0 - нет): ";
+            if (!(cin >> echo)) {
+                cin.clear();
+                cin.ignore(numeric_limits<streamsize>::max(), '\n');
+                cout << "неверный ввод\n";
                 return;
             }
-    
-            int typeInt;
-            cout << "выберите тип задания (0 - доклад, 1 - лаба): ";
-            cin >> typeInt;
-    
-            if (typeInt != 0 && typeInt != 1) {
-                cout << "неверный тип\n";
-                return;
+            exportAllReports(echo == 1, format);
+        }
+        
+        // сохранить всё состояние в бинарный снимок (ссылки хранятся как id)
+        bool saveSnapshot(const string& path, uint64_t generation) const {
+            METRIC_TIME(Snapshot);
+            BinaryWriter out;
+            out.putBytes(SNAPSHOT_MAGIC, sizeof SNAPSHOT_MAGIC);
+            out.putU32(SNAPSHOT_VERSION);
+            out.putU64(generation);
+            out.putI32(nextUserId);
+            out.putI32(nextSubjectId);
+            out.putI32(nextWorkId);
+
+            // вызывается в точке покоя stateGate, списки и предметы никто не меняет
+            shared_lock<shared_mutex> lists(listsLock);
+            out.putU32(static_cast<uint32_t>(teachers.size()));
+            for (auto* t : teachers) {
+                out.putI32(t->getId());
+                out.putString(t->getName());
+            }
+
+            out.putU32(static_cast<uint32_t>(students.size()));
+            for (auto* st : students) {
+                out.putI32(st->getId());
+                out.putString(st->getName());
+                out.putString(st->getGroup());
+            }
+
+            out.putU32(static_cast<uint32_t>(subjects.size()));
+            for (auto* sub : subjects) {
+                out.putI32(sub->getId());
+                out.putI32(sub->getOwner() ? sub->getOwner()->getId() : 0);
+                out.putString(sub->getName());
+
+                auto lock = sub->readLock();
+                out.putU32(static_cast<uint32_t>(sub->getStudentsList().size()));
+                for (auto* st : sub->getStudentsList()) {
+                    out.putI32(st->getId());
+                }
+
+                out.putU32(static_cast<uint32_t>(sub->slotCount()));
+                for (size_t i = 0; i < sub->slotCount(); ++i) {
+                    const AssignmentSlot slot = sub->slotAt(i);
+                    out.putI32(slot.work->getId());
+                    out.putU8(slot.type == WorkType::Report ? 0 : 1);
+                    out.putString(slot.work->getTitle());
+                    out.putI32(slot.reservedBy ? slot.reservedBy->getId() : 0);
+                    out.putU8(static_cast<uint8_t>((slot.submitted ? 1 : 0) | (slot.approved ? 2 : 0)));
+                    out.putI32(slot.grade);
+                    out.putU32(slotword::version(sub->slotStateAt(i)));
+                }
+            }
+
+            // журнал обрезается только после этого, поэтому снимок должен дойти до диска
+            if (!replaceFileDurably(path, out.buf)) {
+                cout << "ошибка: не удалось записать снимок\n";
+                return false;
             }
-    
-            WorkType type = (typeInt == 0) ? WorkType::Report : WorkType::Lab;
-    
-            cin.ignore(numeric_limits<streamsize>::max(), '\n');
-            string title;
-            cout << "введите название задания: ";
-            getline(cin, title);
-    
-            subj->addWork(type, nextWorkId++, title);
-    
-            cout << "задание добавлено на предмет\n";
+            return true;
         }
-    
-        // студент записывается на конкретное задание
-        void reserveWorkOnSubject() {
-            int subjId, studId, workId;
-            cout << "введите id предмета: ";
-            cin >> subjId;
-            cout << "введите id студента: ";
-            cin >> studId;
-            cout << "введите id задания: ";
-            cin >> workId;
-    
-            Subject* subj = findSubjectById(subjId);
-            Student* stud = findStudentById(studId);
-    
-            if (!subj || !stud) {
-                cout << "неверный id предмета или студента\n";
-                return;
+
+        // загрузить снимок через mmap, система при этом должна быть пустой
+        bool loadSnapshot(const string& path) {
+            MappedFile file;
+            if (!file.open(path)) {
+                return false;
             }
-    
-            subj->reserveWork(workId, stud);
+
+            clear();
+            BinaryReader in{file.data, file.data + file.size};
+            bool ok = readSnapshot(in);
+
+            if (!ok) {
+                clear();
+                cout << "ошибка: файл снимка повреждён, начинаем с пустой системы\n";
+            }
+            return ok;
         }
-    
-        // студент отмечает, что сдал работу
-        void studentSubmitWork() {
-            int subjId, studId, workId;
-            cout << "введите id предмета: ";
-            cin >> subjId;
-            cout << "введите id студента: ";
-            cin >> studId;
-            cout << "введите id задания: ";
-            cin >> workId;
-    
-            Subject* subj = findSubjectById(subjId);
-            Student* stud = findStudentById(studId);
-    
-            if (!subj || !stud) {
-                cout << "неверный id предмета или студента\n";
-                return;
+
+        // сохранить снимок по запросу из меню (журнал после этого начинается заново)
+        void saveSnapshotMenu() {
+            auto quiet = stateGate.quiesce();
+            if (compact()) {
+                cout << "снимок сохранён в файл: " << SNAPSHOT_FILE << "\n";
             }
-    
-            subj->markSubmitted(workId, stud);
         }
-    
-        // преподаватель утверждает работу и ставит оценку
-        void approveWorkOnSubject() {
-            int subjId, workId, grade;
-            cout << "введите id предмета: ";
-            cin >> subjId;
-            cout << "введите id задания: ";
-            cin >> workId;
-            cout << "введите оценку: ";
-            cin >> grade;
-    
-            Subject* subj = findSubjectById(subjId);
-            if (!subj) {
-                cout << "предмет не найден\n";
-                return;
+
+        // отдать журнал на диск (точка фиксации после команды); false - изменения не сохранены
+        bool commitJournal() {
+            return journal.commit();
+        }
+
+        // между командами: если журнал разросся, сворачиваем его в снимок
+        void maybeCompact() {
+            if (journal.recordsSinceSnapshot() < JOURNAL_COMPACT_EVERY) return;
+            auto quiet = stateGate.quiesce();
+            if (journal.recordsSinceSnapshot() >= JOURNAL_COMPACT_EVERY) compact();
+        }
+
+        // при старте подтягиваем последний снимок и дописанный после него журнал
+        void loadOnStartup() {
+            auto start = chrono::steady_clock::now();
+            searchStale = true; // индексировать по одному при загрузке втрое дольше, чем потом разом
+            bool loaded = loadSnapshot(SNAPSHOT_FILE);
+            size_t applied = 0, rejected = 0;
+            size_t validSize = replayJournal(JOURNAL_FILE, applied, rejected);
+            size_t kept = applied + rejected;
+            bool migrated = legacyJournal;
+            if (legacyJournal) {
+                // дописывать новые слова в журнал старого формата нельзя: сворачиваем его в снимок
+                legacyJournal = false;
+                if (!saveSnapshot(SNAPSHOT_FILE, snapshotGeneration + 1)) {
+                    cout << "ошибка: журнал старого формата не переведён, новые изменения в журнал не попадут\n";
+                    return;
+                }
+                ++snapshotGeneration;
+                validSize = 0;
+                kept = 0;
+            }
+            journal.open(JOURNAL_FILE, snapshotGeneration, validSize, kept);
+            if (!loaded && applied == 0 && rejected == 0) return;
+
+            auto ms = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+            cout << "восстановлено состояние: преподавателей " << teachers.size()
+                 << ", студентов " << students.size() << ", предметов " << subjects.size()
+                 << ", записей журнала " << applied << " (" << ms << " мс)\n";
+            if (rejected > 0) {
+                cout << "внимание: записей журнала не применено: " << rejected
+                     << (migrated ? " (журнал переведён в новый формат без них)\n" : " (оставлены в журнале)\n");
             }
-    
-            subj->approveWork(workId, grade);
         }
+        
+        ~UniversitySystem() {
+            clear();
+        }
+        
+    };
     
-        // преподаватель отклоняет работу
-        void rejectWorkOnSubject() {
-            int subjId, workId;
-            cout << "введите id предмета: ";
-            cin >> subjId;
-            cout << "введите id задания: ";
-            cin >> workId;
-    
-            Subject* subj = findSubjectById(subjId);
-            if (!subj) {
-                cout << "предмет не найден\n";
-                return;
+/** @brief Буфер вывода большими кусками прямо в файловый дескриптор */
+class BufferedOutput : public streambuf {
+    private:
+    int fd;
+    vector<char> buffer;
+
+    bool writeOut() {
+        const char* p = pbase();
+        size_t len = static_cast<size_t>(pptr() - pbase());
+        while (len > 0) {
+            ssize_t n = ::write(fd, p, len);
+            if (n < 0 && errno == EINTR) continue; // прерванная сигналом запись - не повод терять вывод
+            if (n < 0) return false;
+            p += n;
+            len -= static_cast<size_t>(n);
+        }
+        setp(buffer.data(), buffer.data() + buffer.size());
+        return true;
+    }
+
+    protected:
+    int overflow(int c) override {
+        if (!writeOut()) return traits_type::eof();
+        if (c != traits_type::eof()) {
+            *pptr() = static_cast<char>(c);
+            pbump(1);
+        }
+        return traits_type::not_eof(c);
+    }
+    int sync() override {
+        return writeOut() ? 0 : -1;
+    }
+
+    public:
+    explicit BufferedOutput(int fd_, size_t size = 1 << 20) : fd(fd_), buffer(size) {
+        setp(buffer.data(), buffer.data() + buffer.size());
+    }
+    ~BufferedOutput() override {
+        writeOut();
+    }
+};
+
+/** @brief Вывод cout, который поток может перехватить в свою строку (сервер: ответ на запрос) */
+class RoutedOutput : public streambuf {
+    private:
+    streambuf* fallback; // куда идёт вывод потоков без перехвата
+    mutex fallbackLock;
+    inline static thread_local string* target = nullptr;
+
+    protected:
+    // своей области записи нет: каждый вывод сразу уходит в строку потока или в fallback
+    int overflow(int c) override {
+        if (c == traits_type::eof()) return traits_type::not_eof(c);
+        if (target) {
+            target->push_back(static_cast<char>(c));
+            return c;
+        }
+        lock_guard<mutex> lock(fallbackLock);
+        return fallback->sputc(static_cast<char>(c));
+    }
+    streamsize xsputn(const char* s, streamsize n) override {
+        if (target) {
+            target->append(s, static_cast<size_t>(n));
+            return n;
+        }
+        lock_guard<mutex> lock(fallbackLock);
+        return fallback->sputn(s, n);
+    }
+    int sync() override {
+        if (target) return 0;
+        lock_guard<mutex> lock(fallbackLock);
+        return fallback->pubsync();
+    }
+
+    public:
+    explicit RoutedOutput(streambuf* fallback_) : fallback(fallback_) {}
+
+    /** @brief Пока жив, вывод этого потока в cout копится в строке */
+    class Capture {
+        string* saved;
+        public:
+        explicit Capture(string& out) : saved(target) { target = &out; }
+        ~Capture() { target = saved; }
+        Capture(const Capture&) = delete;
+        Capture& operator=(const Capture&) = delete;
+    };
+};
+
+/** @brief Весь вывод программы идёт через большой буфер; сброс только в явных точках */
+class OutputSink {
+    private:
+    BufferedOutput buffer;
+    streambuf* saved;
+
+    public:
+    explicit OutputSink(int fd = STDOUT_FILENO) : buffer(fd) {
+        cout.flush();
+        saved = cout.rdbuf(&buffer);
+    }
+    OutputSink(const OutputSink&) = delete;
+    OutputSink& operator=(const OutputSink&) = delete;
+    ~OutputSink() {
+        cout.flush();
+        cout.rdbuf(saved);
+    }
+
+    // точка сброса: накопленное уходит одним write (чтение из cin сбрасывает само через tie)
+    static void flush() {
+        cout.flush();
+    }
+};
+
+/** @brief Фоновый поток: раз в период сбрасывает метрики в файл в формате Prometheus */
+class MetricsDumper {
+    private:
+    string path;
+    chrono::seconds period;
+    mutex lock;
+    condition_variable wake;
+    bool stopping = false;
+    thread worker;
+
+    void dump() {
+        string text;
+        metrics::formatPrometheus(text);
+        // через временный файл и rename: читатель не увидит половину
+        string tmp = path + ".tmp";
+        if (UniversitySystem::writeWholeFile(tmp, text)) rename(tmp.c_str(), path.c_str());
+    }
+
+    public:
+    MetricsDumper(const string& path_, chrono::seconds period_) : path(path_), period(period_) {
+        worker = thread([this] {
+            unique_lock<mutex> guard(lock);
+            while (!wake.wait_for(guard, period, [this] { return stopping; })) {
+                guard.unlock();
+                dump();
+                guard.lock();
             }
-    
-            subj->rejectWork(workId);
+        });
+    }
+    MetricsDumper(const MetricsDumper&) = delete;
+    MetricsDumper& operator=(const MetricsDumper&) = delete;
+    ~MetricsDumper() {
+        {
+            lock_guard<mutex> guard(lock);
+            stopping = true;
         }
-    
-        // студент спрыгивает с задания
-        void dropWorkOnSubject() {
-            int subjId, studId, workId;
-            cout << "введите id предмета: ";
-            cin >> subjId;
-            cout << "введите id студента: ";
-            cin >> studId;
-            cout << "введите id задания: ";
-            cin >> workId;
-    
-            Subject* subj = findSubjectById(subjId);
-            Student* stud = findStudentById(studId);
-    
-            if (!subj || !stud) {
-                cout << "неверный id предмета или студента\n";
-                return;
+        wake.notify_one();
+        worker.join();
+        dump(); // итог на выходе
+    }
+};
+
+/** @brief Пакетный режим: команды из файла или stdin без меню и подсказок */
+class BatchRunner {
+    private:
+    UniversitySystem& sys;
+    bool serving;               // запросы сервера: вывод перехвачен RoutedOutput, ошибки без номера строки
+    vector<string> diagnostics; // ошибки копим и выводим в конце
+    ostringstream captured;     // сюда уходит болтовня предметной области во время изменяющих команд
+    size_t lines = 0;
+    size_t commands = 0;
+
+    static bool readInt(istringstream& args, int& value) {
+        return static_cast<bool>(args >> value);
+    }
+    // остаток строки без ведущих пробелов (имена и названия могут содержать пробелы)
+    static string rest(istringstream& args) {
+        string text;
+        getline(args >> ws, text);
+        return text;
+    }
+
+    void fail(const string& reason) {
+        diagnostics.push_back(serving ? reason : "строка " + to_string(lines) + ": " + reason);
+    }
+
+    // изменяющая команда: её вывод перехватываем и показываем только при ошибке
+    template <typename Op>
+    void mutate(Op op) {
+        string text;
+        bool ok;
+        if (serving) {
+            RoutedOutput::Capture capture(text);
+            ok = op();
+        } else {
+            captured.str("");
+            streambuf* saved = cout.rdbuf(captured.rdbuf());
+            ok = op();
+            cout.rdbuf(saved);
+            text = captured.str();
+        }
+        if (!ok) {
+            while (!text.empty() && text.back() == '\n') text.pop_back();
+            fail(text.empty() ? "команда не выполнена" : text);
+        } else if (serving) {
+            cout << text; // клиенту сервера отдаём и вывод успешной команды
+        }
+    }
+    // клиенту сервера id новых объектов не вывести из порядка команд, поэтому отдаём их явно
+    template <typename T>
+    bool created(T* item) {
+        if (item && serving) cout << "id " << item->getId() << "\n";
+        return item != nullptr;
+    }
+
+    void execute(const string& line) {
+        istringstream args(line);
+        string cmd;
+        if (!(args >> cmd) || cmd[0] == '#') return;
+        ++commands;
+
+        int a = 0, b = 0, c = 0;
+        if (cmd == "teacher") {
+            string name = rest(args);
+            if (name.empty()) return fail("teacher: нужно имя");
+            mutate([&] { return created(sys.addTeacher(name)); });
+        } else if (cmd == "student") {
+            string group;
+            if (!(args >> group)) return fail("student: нужны группа и имя");
+            string name = rest(args);
+            if (name.empty()) return fail("student: нужны группа и имя");
+            mutate([&] { return created(sys.addStudent(name, group)); });
+        } else if (cmd == "subject") {
+            if (!readInt(args, a)) return fail("subject: нужны id преподавателя и название");
+            string name = rest(args);
+            if (name.empty()) return fail("subject: нужны id преподавателя и название");
+            mutate([&] { return created(sys.addSubject(a, name)); });
+        } else if (cmd == "enroll") {
+            if (!readInt(args, a) || !readInt(args, b)) return fail("enroll: нужны id предмета и студента");
+            mutate([&] { return sys.enrollStudentToSubject(a, b); });
+        } else if (cmd == "enrollgroup") {
+            if (!readInt(args, a)) return fail("enrollgroup: нужны id предмета и группа");
+            string group = rest(args);
+            if (group.empty()) return fail("enrollgroup: нужны id предмета и группа");
+            mutate([&] { return sys.findSubjectById(a) && (sys.enrollGroupToSubject(a, group), true); });
+        } else if (cmd == "work") {
+            string type;
+            if (!readInt(args, a) || !(args >> type) || (type != "report" && type != "lab")) {
+                return fail("work: нужны id предмета, тип report|lab и название");
             }
-    
-            subj->dropWork(workId, stud);
+            string title = rest(args);
+            WorkType wt = type == "report" ? WorkType::Report : WorkType::Lab;
+            mutate([&] {
+                int workId = sys.addWorkToSubject(a, wt, title);
+                if (workId != 0 && serving) cout << "id " << workId << "\n";
+                return workId != 0;
+            });
+        } else if (cmd == "reserve" || cmd == "submit" || cmd == "drop") {
+            if (!readInt(args, a) || !readInt(args, b) || !readInt(args, c)) {
+                return fail(cmd + ": нужны id предмета, студента и задания");
+            }
+            if (cmd == "reserve") mutate([&] { return sys.reserveWorkOnSubject(a, b, c); });
+            else if (cmd == "submit") mutate([&] { return sys.studentSubmitWork(a, b, c); });
+            else mutate([&] { return sys.dropWorkOnSubject(a, b, c); });
+        } else if (cmd == "approve") {
+            if (!readInt(args, a) || !readInt(args, b) || !readInt(args, c)) {
+                return fail("approve: нужны id предмета, задания и оценка");
+            }
+            mutate([&] { return sys.approveWorkOnSubject(a, b, c); });
+        } else if (cmd == "reject") {
+            if (!readInt(args, a) || !readInt(args, b)) return fail("reject: нужны id предмета и задания");
+            mutate([&] { return sys.rejectWorkOnSubject(a, b); });
+        } else if (cmd == "subjects") {
+            sys.listSubjects();
+        } else if (cmd == "students") {
+            sys.listStudents();
+        } else if (cmd == "teachers") {
+            sys.listTeachers();
+        } else if (cmd == "owners") {
+            sys.listTeachersBySubjects();
+        } else if (cmd == "stats") {
+            // stats subject <id> | stats group <группа> | stats all
+            string what;
+            args >> what;
+            if (what == "subject" && readInt(args, a)) {
+                if (!sys.showSubjectStats(a)) fail("предмет " + to_string(a) + " не найден");
+            } else if (what == "group") {
+                string group = rest(args);
+                if (group.empty()) return fail("stats group: нужна группа");
+                sys.showGroupStats(group);
+            } else if (what == "all") {
+                sys.showUniversityStats();
+            } else {
+                fail("stats: subject <id> | group <группа> | all");
+            }
+        } else if (cmd == "summary") {
+            // summary [id предмета] - по счётчикам, без обхода слотов
+            if (readInt(args, a)) {
+                if (!sys.showSubjectSummary(a)) fail("предмет " + to_string(a) + " не найден");
+            } else {
+                sys.showSummary();
+            }
+        } else if (cmd == "verify") {
+            if (!sys.verifyCounters()) fail("verify: счётчики разошлись с обходом");
+        } else if (cmd == "statsbench") {
+            if (!readInt(args, a)) a = 10;
+            sys.benchmarkStats(a);
+        } else if (cmd == "memstats") {
+            sys.showMemoryStats();
+        } else if (cmd == "metrics") {
+            // metrics [prom]
+            string format;
+            args >> format;
+            if (format == "prom") {
+                string text;
+                metrics::formatPrometheus(text);
+                cout << text;
+            } else {
+                metrics::printReport();
+            }
+        } else if (cmd == "show") {
+            if (!readInt(args, a)) return fail("show: нужен id предмета");
+            if (!sys.showSubjectDetails(a)) fail("предмет " + to_string(a) + " не найден");
+        } else if (cmd == "groups") {
+            sys.listGroups();
+        } else if (cmd == "group") {
+            string group = rest(args);
+            if (group.empty()) return fail("group: нужна группа");
+            if (!sys.showGroupActivity(group)) fail("в группе " + group + " нет студентов");
+        } else if (cmd == "search") {
+            // search [prefix] <текст>
+            string query = rest(args);
+            bool prefix = query.compare(0, 7, "prefix ") == 0;
+            if (prefix) query.erase(0, query.find_first_not_of(' ', 7));
+            if (query.empty()) return fail("search: нужен текст");
+            sys.search(query, prefix);
+        } else if (cmd == "activity") {
+            if (!readInt(args, a)) return fail("activity: нужен id студента");
+            if (!sys.showStudentActivity(a)) fail("студент " + to_string(a) + " не найден");
+        } else if (cmd == "export") {
+            // export <id> [text|csv|json] [force]
+            ReportFormat format = ReportFormat::Text;
+            bool force = false;
+            string word;
+            if (!readInt(args, a)) return fail("export: нужен id предмета");
+            while (args >> word) {
+                if (word == "force") force = true;
+                else if (!parseReportFormat(word, format)) return fail("export: формат text|csv|json");
+            }
+            mutate([&] { return sys.exportSubjectReport(a, format, force); });
+        } else if (cmd == "import") {
+            static const pair<const char*, ImportKind> kinds[] = {
+                {"teachers", ImportKind::Teachers}, {"students", ImportKind::Students},
+                {"subjects", ImportKind::Subjects}, {"works", ImportKind::Works}};
+            string what;
+            args >> what;
+            string path = rest(args);
+            const ImportKind* kind = nullptr;
+            for (const auto& k : kinds) {
+                if (what == k.first) kind = &k.second;
+            }
+            if (!kind || path.empty()) return fail("import: нужны teachers|students|subjects|works и путь");
+            ImportResult r = sys.importCsv(*kind, path);
+            UniversitySystem::printImportResult(r);
+            if (r.imported == 0 && !r.errors.empty()) fail("import: " + r.errors.front());
+        } else if (cmd == "exportall") {
+            // exportall [text|csv|json] [echo] [force]
+            ReportFormat format = ReportFormat::Text;
+            bool echo = false, force = false;
+            string word;
+            while (args >> word) {
+                if (word == "echo") echo = true;
+                else if (word == "force") force = true;
+                else if (!parseReportFormat(word, format)) return fail("exportall: формат text|csv|json");
+            }
+            if (sys.exportAllReports(echo, format, force) == 0) fail("exportall: отчёты не выгружены");
+        } else if (cmd == "save") {
+            mutate([&] { sys.saveSnapshotMenu(); return true; });
+        } else {
+            --commands;
+            fail("неизвестная команда: " + cmd);
         }
-    
-        // вывести список предметов (кратко)
-        void listSubjects() const {
-            if (subjects.empty()) {
-                cout << "нет предметов\n";
-                return;
+    }
+
+    public:
+    explicit BatchRunner(UniversitySystem& sys_, bool serving_ = false) : sys(sys_), serving(serving_) {}
+
+    // один запрос сервера: вывод команды и ошибки уходят в ответ, true если ошибок не было
+    bool runRequest(const string& line, string& response) {
+        diagnostics.clear();
+        ++lines;
+        {
+            METRIC_TIME(Request);
+            RoutedOutput::Capture capture(response);
+            execute(line);
+        }
+        for (const string& d : diagnostics) {
+            response += d;
+            response += '\n';
+        }
+        return diagnostics.empty();
+    }
+
+    // выполнить скрипт целиком, возвращает число ошибок
+    size_t run(istream& in) {
+        // вывод сбрасываем сами в конце, а не на каждой прочитанной строке; подтверждения всё равно не показываются
+        ostream* tied = in.tie(nullptr);
+        bool wasQuiet = quietOutput;
+        quietOutput = true;
+        auto start = chrono::steady_clock::now();
+
+        string line;
+        while (getline(in, line)) {
+            ++lines;
+            {
+                METRIC_TIME(BatchCommand);
+                execute(line);
+            }
+#if UNI_VERIFY_COUNTERS
+            if (!sys.verifyCounters(false)) diagnostics.push_back("строка " + to_string(lines) + ": счётчики разошлись");
+#endif
+            sys.maybeCompact();
+        }
+        if (!sys.commitJournal()) diagnostics.push_back("журнал не записан, изменения пакета не сохранены");
+
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        for (const string& d : diagnostics) {
+            cout << d << "\n";
+        }
+        cout << "пакет: строк " << lines << ", команд " << commands
+             << ", ошибок " << diagnostics.size()
+             << ", время " << static_cast<long long>(seconds * 1000) << " мс";
+        if (seconds > 0) {
+            cout << ", " << static_cast<long long>(commands / seconds) << " команд/с";
+        }
+        cout << "\n";
+        OutputSink::flush();
+
+        quietOutput = wasQuiet;
+        in.tie(tied);
+        return diagnostics.size();
+    }
+};
+
+const char* const SERVER_SOCKET = "university.sock";
+
+/** @brief Кадр ответа сервера: строка "ok|err <байт>", за ней тело */
+void appendFrame(string& out, bool ok, const string& body) {
+    out += ok ? "ok " : "err ";
+    out += to_string(body.size());
+    out += '\n';
+    out += body;
+}
+
+// сигналы остановки сервера: он читает их через signalfd
+inline sigset_t shutdownSignals() {
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    return mask;
+}
+// маска действует на поток и наследуется новыми потоками, поэтому ставить её нужно до первого из них:
+// иначе сигнал достанется, например, потоку сброса метрик с обработчиком по умолчанию и убьёт процесс
+inline void blockShutdownSignals() {
+    sigset_t mask = shutdownSignals();
+    pthread_sigmask(SIG_BLOCK, &mask, nullptr);
+}
+
+/** @brief Сервер запросов: цикл epoll на Unix-сокете, команды пакетного режима выполняет пул воркеров */
+class RequestServer {
+    private:
+    // соединение обслуживает не больше одного воркера за раз, поэтому ответы идут в порядке запросов
+    struct Connection {
+        int fd;
+        string in;               // хвост без \n, ждёт продолжения
+        deque<string> requests;  // полные строки, ждут воркера
+        string out;              // готовые ответы, ждут отправки
+        bool scheduled = false;  // стоит в очереди или у воркера
+        bool peerClosed = false; // клиент закрыл свою сторону: дошлём ответы и закроем
+        bool writing = false;    // сокет забит, ждём EPOLLOUT
+        mutex lock;              // requests, out и флаги делят цикл и воркер
+        explicit Connection(int fd_) : fd(fd_) {}
+    };
+
+    static constexpr size_t MAX_LINE = 64 * 1024; // строка длиннее без \n - рвём соединение
+    static constexpr size_t MAX_BATCH = 256;      // запросов соединения за один заход воркера
+
+    UniversitySystem& sys;
+    string path;
+    int listenFd = -1, epollFd = -1, wakeFd = -1, signalFd = -1;
+    unordered_map<int, shared_ptr<Connection>> connections; // только поток цикла
+
+    mutex queueLock;
+    condition_variable queueReady;
+    deque<shared_ptr<Connection>> queue; // соединения с невыполненными запросами
+    bool stopping = false;
+
+    mutex readyLock;
+    vector<shared_ptr<Connection>> ready; // воркер дописал ответы, циклу пора их отправить
+
+    atomic<size_t> served{0}, failed{0};
+    size_t accepted = 0;
+
+    void watch(int fd, uint32_t events, int op = EPOLL_CTL_ADD) {
+        epoll_event ev{};
+        ev.events = events;
+        ev.data.fd = fd;
+        epoll_ctl(epollFd, op, fd, &ev);
+    }
+
+    void updateInterest(Connection& conn) {
+        uint32_t events = 0;
+        if (!conn.peerClosed) events |= EPOLLIN | EPOLLRDHUP;
+        if (conn.writing) events |= EPOLLOUT;
+        watch(conn.fd, events, EPOLL_CTL_MOD);
+    }
+
+    void schedule(shared_ptr<Connection> conn) {
+        {
+            lock_guard<mutex> lock(queueLock);
+            queue.push_back(move(conn));
+        }
+        queueReady.notify_one();
+    }
+
+    void drop(const shared_ptr<Connection>& conn) {
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, conn->fd, nullptr);
+        close(conn->fd);
+        connections.erase(conn->fd);
+    }
+
+    bool open() {
+        struct stat st;
+        if (::stat(path.c_str(), &st) == 0 && !S_ISSOCK(st.st_mode)) {
+            cout << "ошибка: " << path << " существует и это не сокет\n";
+            return false;
+        }
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+            cout << "ошибка: недопустимый путь сокета " << path << "\n";
+            return false;
+        }
+        memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+        unlink(path.c_str()); // сокет от прошлого запуска
+
+        listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listenFd < 0 || bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+            listen(listenFd, SOMAXCONN) != 0) {
+            cout << "ошибка: не удалось открыть сокет " << path << ": " << strerror(errno) << "\n";
+            return false;
+        }
+        // SIGINT/SIGTERM читаем через signalfd; main уже заблокировал их до первого потока,
+        // здесь - на случай, если сервер поднимают не из main
+        sigset_t mask = shutdownSignals();
+        pthread_sigmask(SIG_BLOCK, &mask, nullptr);
+        signalFd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (signalFd < 0 || epollFd < 0 || wakeFd < 0) {
+            cout << "ошибка: не удалось запустить цикл событий: " << strerror(errno) << "\n";
+            return false;
+        }
+        watch(listenFd, EPOLLIN);
+        watch(signalFd, EPOLLIN);
+        watch(wakeFd, EPOLLIN);
+        return true;
+    }
+
+    void acceptAll() {
+        while (true) {
+            int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno == EINTR) continue;
+                return; // EAGAIN - все приняты; EMFILE и прочее - попробуем на следующем событии
+            }
+            connections[fd] = make_shared<Connection>(fd);
+            watch(fd, EPOLLIN | EPOLLRDHUP);
+            ++accepted;
+        }
+    }
+
+    void readFrom(const shared_ptr<Connection>& conn) {
+        char buf[16384];
+        bool closedNow = false;
+        while (true) {
+            ssize_t r = recv(conn->fd, buf, sizeof(buf), 0);
+            if (r > 0) {
+                conn->in.append(buf, static_cast<size_t>(r));
+                continue;
+            }
+            if (r < 0 && errno == EINTR) continue;
+            if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            if (r < 0) return drop(conn);
+            closedNow = true;
+            break;
+        }
+
+        // режем на строки; все запросы одного чтения уходят воркеру одной пачкой
+        bool wake = false;
+        {
+            lock_guard<mutex> lock(conn->lock);
+            size_t start = 0, nl;
+            while ((nl = conn->in.find('\n', start)) != string::npos) {
+                size_t end = nl > start && conn->in[nl - 1] == '\r' ? nl - 1 : nl;
+                conn->requests.emplace_back(conn->in, start, end - start);
+                start = nl + 1;
             }
-    
-            cout << "список предметов:\n";
-            for (auto* s : subjects) {
-                s->printShort();
+            conn->in.erase(0, start);
+            if (conn->in.size() > MAX_LINE) {
+                conn->peerClosed = true;
+                conn->in.clear();
+            }
+            if (closedNow) conn->peerClosed = true;
+            if (!conn->requests.empty() && !conn->scheduled) {
+                conn->scheduled = true;
+                wake = true;
             }
+            if (conn->peerClosed) updateInterest(*conn);
         }
+        if (wake) schedule(conn);
+        if (conn->peerClosed) sendOut(conn);
+    }
 
-        // вывести список всех студентов
-        void listStudents() const {
-            if (students.empty()) {
-                cout << "студентов нет\n";
-                return;
+    void sendOut(const shared_ptr<Connection>& conn) {
+        bool finished = false, gone = false;
+        {
+            lock_guard<mutex> lock(conn->lock);
+            size_t off = 0;
+            while (off < conn->out.size()) {
+                ssize_t w = send(conn->fd, conn->out.data() + off, conn->out.size() - off, MSG_NOSIGNAL);
+                if (w > 0) {
+                    off += static_cast<size_t>(w);
+                } else if (w < 0 && errno == EINTR) {
+                    continue;
+                } else if (w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                    break;
+                } else {
+                    gone = true; // клиент ушёл, ответы никому не нужны
+                    break;
+                }
             }
-            cout << "список студентов:\n";
-            for (auto* s : students) {
-                cout << "  id " << s->getId()
-                     << ": " << s->getName()
-                     << " (группа: " << s->getGroup() << ")\n";
+            if (gone) {
+                conn->out.clear();
+                conn->requests.clear();
+            } else {
+                conn->out.erase(0, off);
+                bool pending = !conn->out.empty();
+                if (pending != conn->writing) {
+                    conn->writing = pending;
+                    updateInterest(*conn);
+                }
+                finished = conn->peerClosed && conn->out.empty() && conn->requests.empty() && !conn->scheduled;
             }
         }
+        // воркер может ещё держать соединение: допишет ответы в закрытое, flushReady их не отправит
+        if (gone || finished) drop(conn);
+    }
 
-        // вывести список всех преподавателей
-        void listTeachers() const {
-            if (teachers.empty()) {
-                cout << "преподавателей нет\n";
-                return;
+    // воркеры дописали ответы: отправляем, пока соединение ещё наше
+    void flushReady() {
+        vector<shared_ptr<Connection>> batch;
+        {
+            lock_guard<mutex> lock(readyLock);
+            batch.swap(ready);
+        }
+        for (const auto& conn : batch) {
+            auto it = connections.find(conn->fd);
+            if (it != connections.end() && it->second == conn) sendOut(conn);
+        }
+    }
+
+    void worker() {
+        BatchRunner runner(sys, true);
+        vector<string> taken;
+        vector<pair<bool, string>> results;
+        string answers;
+        while (true) {
+            shared_ptr<Connection> conn;
+            {
+                unique_lock<mutex> lock(queueLock);
+                queueReady.wait(lock, [&] { return stopping || !queue.empty(); });
+                if (queue.empty()) return; // остановка, очередь разобрана
+                conn = move(queue.front());
+                queue.pop_front();
             }
-            cout << "список преподавателей:\n";
-            for (auto* t : teachers) {
-                cout << "  id " << t->getId()
-                     << ": " << t->getName()
-                     << " (роль: " << t->getRole() << ")\n";
+            taken.clear();
+            {
+                lock_guard<mutex> lock(conn->lock);
+                while (!conn->requests.empty() && taken.size() < MAX_BATCH) {
+                    taken.push_back(move(conn->requests.front()));
+                    conn->requests.pop_front();
+                }
+            }
+            results.resize(taken.size()); // строки ответов переиспользуют память с прошлых пачек
+            for (size_t i = 0; i < taken.size(); ++i) {
+                results[i].second.clear();
+                results[i].first = runner.runRequest(taken[i], results[i].second);
+            }
+            // ответы отдаём только после записи журнала: одна синхронизация на пачку запросов
+            bool durable = sys.commitJournal();
+            sys.maybeCompact();
+            answers.clear();
+            for (size_t i = 0; i < taken.size(); ++i) {
+                bool ok = results[i].first && durable;
+                // без записи на диск успех подтверждать нельзя
+                if (results[i].first && !durable) results[i].second = "ошибка: не удалось записать журнал\n";
+                appendFrame(answers, ok, results[i].second);
+                ++served;
+                if (!ok) ++failed;
+            }
+
+            bool more;
+            {
+                lock_guard<mutex> lock(conn->lock);
+                conn->out += answers;
+                more = !conn->requests.empty();
+                conn->scheduled = more;
+            }
+            {
+                lock_guard<mutex> lock(readyLock);
+                ready.push_back(conn);
             }
+            uint64_t one = 1;
+            ssize_t ignored = write(wakeFd, &one, sizeof(one));
+            (void)ignored;
+            if (more) schedule(move(conn));
         }
+    }
 
-        // вывести преподавателей по предметам
-        void listTeachersBySubjects() const {
-            if (subjects.empty()) {
-                cout << "нет предметов\n";
-                return;
+    void closeAll() {
+        for (auto& entry : connections) close(entry.first);
+        connections.clear();
+        for (int fd : {listenFd, epollFd, wakeFd, signalFd}) {
+            if (fd >= 0) close(fd);
+        }
+        if (listenFd >= 0) unlink(path.c_str());
+        listenFd = epollFd = wakeFd = signalFd = -1;
+    }
+
+    public:
+    RequestServer(UniversitySystem& sys_, const string& path_) : sys(sys_), path(path_) {}
+    RequestServer(const RequestServer&) = delete;
+    RequestServer& operator=(const RequestServer&) = delete;
+    ~RequestServer() { closeAll(); }
+
+    // работает до SIGINT/SIGTERM; вывод воркеров перехватывается, поэтому cout должен смотреть в RoutedOutput
+    bool run(int threads) {
+        if (!open()) {
+            closeAll();
+            return false;
+        }
+        threads = max(1, threads);
+        vector<thread> workers;
+        for (int t = 0; t < threads; ++t) workers.emplace_back([this] { worker(); });
+        cout << "сервер слушает " << path << ", воркеров " << threads << "\n";
+        cout.flush();
+
+        epoll_event events[64];
+        bool running = true;
+        while (running) {
+            int n = epoll_wait(epollFd, events, 64, -1);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                cout << "ошибка: epoll_wait: " << strerror(errno) << "\n";
+                break;
             }
-            cout << "преподаватели по предметам:\n";
-            for (auto* sub : subjects) {
-                cout << "  предмет #" << sub->getId()
-                     << " \"" << sub->getName() << "\"";
-                if (sub->getOwner()) {
-                    cout << " → " << sub->getOwner()->getName();
+            for (int i = 0; i < n; ++i) {
+                int fd = events[i].data.fd;
+                if (fd == listenFd) {
+                    acceptAll();
+                } else if (fd == signalFd) {
+                    signalfd_siginfo info;
+                    while (read(signalFd, &info, sizeof(info)) > 0) {}
+                    running = false;
+                } else if (fd == wakeFd) {
+                    uint64_t count;
+                    while (read(wakeFd, &count, sizeof(count)) > 0) {}
+                    flushReady();
                 } else {
-                    cout << " → (нет преподавателя)";
+                    auto it = connections.find(fd);
+                    if (it == connections.end()) continue;
+                    shared_ptr<Connection> conn = it->second;
+                    if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) readFrom(conn);
+                    it = connections.find(fd);
+                    // клиент закрыл сокет целиком: принятые запросы воркеры выполнят, ответы отдавать некому
+                    if (it != connections.end() && it->second == conn && (events[i].events & (EPOLLHUP | EPOLLERR))) {
+                        drop(conn);
+                        continue;
+                    }
+                    if (it != connections.end() && it->second == conn && (events[i].events & EPOLLOUT)) sendOut(conn);
                 }
-                cout << "\n";
             }
         }
 
-        // показать активность студента по всем предметам
-        void showStudentActivity() const {
-            if (students.empty()) {
-                cout << "нет студентов\n";
-                return;
-            }
+        {
+            lock_guard<mutex> lock(queueLock);
+            stopping = true;
+        }
+        queueReady.notify_all();
+        for (auto& th : workers) th.join();
+        flushReady(); // последнее, что успели ответить
+        closeAll();
+        cout << "сервер остановлен: соединений " << accepted << ", запросов " << served
+             << ", с ошибкой " << failed << "\n";
+        return true;
+    }
+};
 
-            int studId;
-            cout << "введите id студента: ";
-            cin >> studId;
+/** @brief Клиент сервера запросов: блокирующий сокет, ответы разбираются по кадрам */
+class ServerClient {
+    private:
+    int fd = -1;
+    string buf;     // принятые, но ещё не разобранные байты
+    size_t pos = 0; // начало неразобранного в buf
 
-            Student* stud = nullptr;
-            for (auto* s : students) {
-                if (s->getId() == studId) {
-                    stud = s;
-                    break;
+    public:
+    ServerClient() = default;
+    ServerClient(const ServerClient&) = delete;
+    ServerClient& operator=(const ServerClient&) = delete;
+    ~ServerClient() {
+        if (fd >= 0) close(fd);
+    }
+
+    bool connectTo(const string& path) {
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        if (path.empty() || path.size() >= sizeof(addr.sun_path)) return false;
+        memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        return fd >= 0 && connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0;
+    }
+
+    bool sendAll(const string& data) {
+        size_t off = 0;
+        while (off < data.size()) {
+            ssize_t w = send(fd, data.data() + off, data.size() - off, MSG_NOSIGNAL);
+            if (w < 0 && errno == EINTR) continue;
+            if (w <= 0) return false;
+            off += static_cast<size_t>(w);
+        }
+        return true;
+    }
+
+    // следующий ответ по порядку; false - соединение оборвалось или кадр битый
+    bool receive(bool& ok, string& body) {
+        while (true) {
+            size_t nl = buf.find('\n', pos);
+            if (nl != string::npos) {
+                size_t space = buf.find(' ', pos);
+                if (space == string::npos || space > nl) return false;
+                size_t len = 0;
+                auto parsed = from_chars(buf.data() + space + 1, buf.data() + nl, len);
+                if (parsed.ec != errc()) return false;
+                if (buf.size() - (nl + 1) >= len) {
+                    ok = buf.compare(pos, space - pos, "ok") == 0;
+                    body.assign(buf, nl + 1, len);
+                    pos = nl + 1 + len;
+                    if (pos == buf.size()) {
+                        buf.clear();
+                        pos = 0;
+                    }
+                    return true;
                 }
             }
-
-            if (!stud) {
-                cout << "студент не найден\n";
-                return;
+            if (pos > 0) {
+                buf.erase(0, pos);
+                pos = 0;
             }
+            char chunk[16384];
+            ssize_t r = recv(fd, chunk, sizeof(chunk), 0);
+            if (r < 0 && errno == EINTR) continue;
+            if (r <= 0) return false;
+            buf.append(chunk, static_cast<size_t>(r));
+        }
+    }
 
-            cout << "\n=== активность студента: " << stud->getName() << " ===\n";
+    // запрос без конвейера: отправили, дождались ответа
+    bool call(const string& line, string& body) {
+        bool ok = false;
+        return sendAll(line + "\n") && receive(ok, body) && ok;
+    }
+};
 
-            bool foundAny = false;
+/** @brief Генератор нагрузки: соединения гонят смешанные запросы с конвейером, считаем задержки */
+int runLoadGen(const string& path, int connections, int requests, int depth) {
+    connections = max(1, connections);
+    requests = max(1, requests);
+    depth = max(1, depth);
+    const int worksPerConnection = 2;
 
-            // пробегаемся по всем предметам
-            for (auto* subj : subjects) {
-                bool onThisSubject = false;
-                for (auto* s : subj->getStudentsList()) {
-                    if (s == stud) {
-                        onThisSubject = true;
-                        break;
+    // подготовка: свои преподаватель, предмет, задания и по студенту на соединение
+    ServerClient setup;
+    if (!setup.connectTo(path)) {
+        cout << "ошибка: не удалось подключиться к " << path << "\n";
+        return 1;
+    }
+    string body;
+    auto createId = [&](const string& line) {
+        if (!setup.call(line, body) || body.compare(0, 3, "id ") != 0) {
+            cout << "ошибка подготовки: " << line << ": " << body;
+            return 0;
+        }
+        return atoi(body.c_str() + 3);
+    };
+    int teacherId = createId("teacher нагрузка");
+    int subjId = teacherId ? createId("subject " + to_string(teacherId) + " нагрузочный предмет") : 0;
+    if (!subjId) return 1;
+    vector<int> works, studs;
+    for (int k = 0; k < connections * worksPerConnection; ++k) {
+        works.push_back(createId("work " + to_string(subjId) + " lab лаба " + to_string(k + 1)));
+        if (!works.back()) return 1;
+    }
+    for (int c = 0; c < connections; ++c) {
+        studs.push_back(createId("student нагрузка студент " + to_string(c + 1)));
+        if (!studs.back() || !setup.call("enroll " + to_string(subjId) + " " + to_string(studs.back()), body)) {
+            cout << "ошибка подготовки: студент " << c + 1 << "\n";
+            return 1;
+        }
+    }
+
+    vector<vector<uint32_t>> latencies(static_cast<size_t>(connections)); // мкс
+    atomic<size_t> rejected{0}, broken{0};
+    string subj = to_string(subjId) + " ";
+    auto start = chrono::steady_clock::now();
+    vector<thread> pool;
+    for (int c = 0; c < connections; ++c) {
+        pool.emplace_back([&, c] {
+            ServerClient client;
+            if (!client.connectTo(path)) {
+                ++broken;
+                return;
+            }
+            vector<uint32_t>& lat = latencies[static_cast<size_t>(c)];
+            lat.reserve(static_cast<size_t>(requests));
+            string stud = to_string(studs[static_cast<size_t>(c)]);
+            minstd_rand rng(static_cast<unsigned>(c + 1));
+            deque<chrono::steady_clock::time_point> inflight;
+            string batch, answer;
+            int sent = 0;
+            while (lat.size() < static_cast<size_t>(requests)) {
+                // доливаем конвейер до нужной глубины одной отправкой
+                batch.clear();
+                size_t added = 0;
+                while (sent < requests && inflight.size() + added < static_cast<size_t>(depth)) {
+                    string work = to_string(works[rng() % works.size()]);
+                    unsigned dice = rng() % 100;
+                    if (dice < 30) batch += "reserve " + subj + stud + " " + work + "\n";
+                    else if (dice < 45) batch += "submit " + subj + stud + " " + work + "\n";
+                    else if (dice < 55) batch += "approve " + subj + work + " " + to_string(rng() % 11) + "\n";
+                    else if (dice < 70) batch += "drop " + subj + stud + " " + work + "\n";
+                    else if (dice < 90) batch += "activity " + stud + "\n";
+                    else batch += "stats subject " + subj + "\n";
+                    ++sent;
+                    ++added;
+                }
+                if (added) {
+                    inflight.insert(inflight.end(), added, chrono::steady_clock::now());
+                    if (!client.sendAll(batch)) {
+                        ++broken;
+                        return;
                     }
                 }
-                if (!onThisSubject) {
-                    continue;
+                bool ok = false;
+                if (!client.receive(ok, answer)) {
+                    ++broken;
+                    return;
                 }
+                auto took = chrono::steady_clock::now() - inflight.front();
+                inflight.pop_front();
+                lat.push_back(static_cast<uint32_t>(chrono::duration_cast<chrono::microseconds>(took).count()));
+                if (!ok) ++rejected;
+            }
+        });
+    }
+    for (auto& th : pool) th.join();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
 
-                cout << "\nпредмет: " << subj->getName() << "\n";
+    vector<uint32_t> all;
+    for (const auto& lat : latencies) all.insert(all.end(), lat.begin(), lat.end());
+    sort(all.begin(), all.end());
+    auto percentile = [&](double p) {
+        return all.empty() ? 0u : all[min(all.size() - 1, static_cast<size_t>(p * static_cast<double>(all.size())))];
+    };
+    cout << "нагрузка: соединений " << connections << ", запросов на соединение " << requests
+         << ", конвейер " << depth << "\n";
+    cout << "  ответов " << all.size() << " за " << static_cast<long long>(seconds * 1000) << " мс";
+    if (seconds > 0) cout << ", " << static_cast<long long>(all.size() / seconds) << " запросов/с";
+    cout << ", отказов " << rejected << "\n";
+    cout << "  задержка: p50 " << percentile(0.50) << " мкс, p99 " << percentile(0.99) << " мкс, p99.9 "
+         << percentile(0.999) << " мкс, макс " << (all.empty() ? 0u : all.back()) << " мкс\n";
+    if (broken) cout << "  оборванных соединений " << broken << "\n";
+    return broken ? 1 : 0;
+}
 
-                for (const auto& slot : subj->getAssignmentsList()) {
-                    if (slot.work == nullptr) continue;
+// пустой временный каталог для проверок и бенчмарков, чтобы не трогать файлы в текущем
+inline bool makeScratchDir(string& dir) {
+    char name[] = "/tmp/university-XXXXXX";
+    if (!mkdtemp(name)) return false;
+    dir = name;
+    return true;
+}
+// убрать временный каталог вместе с файлами (вложенных каталогов там не заводим)
+inline void removeScratchDir(const string& dir) {
+    if (DIR* d = opendir(dir.c_str())) {
+        while (dirent* entry = readdir(d)) {
+            string name = entry->d_name;
+            if (name != "." && name != "..") unlink((dir + "/" + name).c_str());
+        }
+        closedir(d);
+    }
+    rmdir(dir.c_str());
+}
 
-                    // если слот свободен – это не "делает студент", пропускаем
-                    if (slot.reservedBy != stud) {
-                        continue;
-                    }
+// мягкая остановка сервера: дочерний процесс поднимает --serve в пустом каталоге со всеми своими
+// потоками (воркеры, сброс метрик), получает сигнал и должен выйти с кодом 0, сохранить снимок и убрать сокет
+int runShutdownTest() {
+    bool allOk = true;
+    for (int sig : {SIGINT, SIGTERM}) {
+        string dir;
+        if (!makeScratchDir(dir)) {
+            cout << "ошибка: не удалось создать временный каталог: " << strerror(errno) << "\n";
+            return 1;
+        }
+        pid_t pid = fork();
+        if (pid < 0) {
+            cout << "ошибка: fork: " << strerror(errno) << "\n";
+            removeScratchDir(dir);
+            return 1;
+        }
+        if (pid == 0) {
+            int devnull = ::open("/dev/null", O_WRONLY);
+            if (devnull < 0 || chdir(dir.c_str()) != 0) _exit(127);
+            dup2(devnull, STDOUT_FILENO);
+            execl("/proc/self/exe", "university", "--serve", SERVER_SOCKET, "2", static_cast<char*>(nullptr));
+            _exit(127);
+        }
 
-                    foundAny = true;
+        // ждём сокет до 10 с и проверяем, что сервер действительно обслуживает запросы
+        string sock = dir + "/" + SERVER_SOCKET;
+        bool served = false;
+        for (int attempt = 0; attempt < 200 && !served; ++attempt) {
+            ServerClient client;
+            string body;
+            if (client.connectTo(sock)) {
+                served = client.call("teacher проверка остановки", body);
+                break;
+            }
+            this_thread::sleep_for(chrono::milliseconds(50));
+        }
 
-                    cout << " - " << slot.work->getTypeName()
-                         << " \"" << slot.work->getTitle() << "\"";
+        kill(pid, sig);
+        int status = 0;
+        bool exited = false;
+        for (int attempt = 0; attempt < 200 && !exited; ++attempt) {
+            exited = waitpid(pid, &status, WNOHANG) == pid;
+            if (!exited) this_thread::sleep_for(chrono::milliseconds(50));
+        }
+        if (!exited) {
+            kill(pid, SIGKILL);
+            waitpid(pid, &status, 0);
+        }
+        bool cleanExit = exited && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+        bool socketGone = access(sock.c_str(), F_OK) != 0;
+        bool snapshotSaved = access((dir + "/" + SNAPSHOT_FILE).c_str(), F_OK) == 0;
+        removeScratchDir(dir);
 
-                    if (!slot.submitted && !slot.approved) {
-                        cout << " → записан, ещё не сдал\n";
-                    } else if (slot.submitted && !slot.approved) {
-                        cout << " → сдано, ожидает проверки\n";
-                    } else if (slot.approved) {
-                        cout << " → оценка: " << slot.grade << "\n";
-                    } else {
-                        cout << "\n";
-                    }
-                }
-            }
+        bool ok = served && cleanExit && socketGone && snapshotSaved;
+        allOk = allOk && ok;
+        cout << "остановка по " << (sig == SIGINT ? "SIGINT" : "SIGTERM") << ": запрос обслужен " << (served ? "да" : "нет")
+             << ", выход ";
+        if (!exited) cout << "не дождались";
+        else if (WIFEXITED(status)) cout << "с кодом " << WEXITSTATUS(status);
+        else cout << "по сигналу " << WTERMSIG(status);
+        cout << ", сокет убран " << (socketGone ? "да" : "нет") << ", снимок сохранён " << (snapshotSaved ? "да" : "нет")
+             << "\n";
+    }
+    cout << (allOk ? "результат: всё сходится" : "результат: НАЙДЕНЫ ОШИБКИ") << "\n";
+    return allOk ? 0 : 1;
+}
 
-            if (!foundAny) {
-                cout << "у студента нет активных работ\n";
+/** @brief Стресс-тест: десятки потоков рвут одни и те же слоты, потом сверяем состояние */
+int runStressTest(int threads) {
+    threads = max(2, threads);
+    const int subjectCount = 4;
+    const int slotsPerSubject = 64;
+    const int studentsPerThread = 8;
+    const int rounds = 5000; // операций смешанной нагрузки на поток
+
+    struct SlotRef {
+        int subjId;
+        int workId;
+        size_t index; // позиция слота внутри предмета
+    };
+
+    UniversitySystem sys; // своя система в памяти, журнал не открыт и файлы не трогаем
+    vector<SlotRef> slots;
+    vector<int> studentIds;
+    vector<atomic<int>> held(static_cast<size_t>(subjectCount * slotsPerSubject)); // записи минус освобождения
+    size_t doubleBooked = 0, missed = 0, mismatched = 0, badRefs = 0;
+    size_t reserves = 0, ops = 0;
+    double raceSec = 0, mixSec = 0;
+    bool countersOk = false;
+    {
+        MuteCout mute;
+        Teacher* owner = sys.addTeacher("стресс");
+        for (int s = 0; s < subjectCount; ++s) {
+            Subject* subj = sys.addSubject(owner->getId(), "предмет " + to_string(s));
+            for (int k = 0; k < slotsPerSubject; ++k) {
+                int wid = sys.addWorkToSubject(subj->getId(), k % 2 ? WorkType::Lab : WorkType::Report, "задание " + to_string(k));
+                slots.push_back({subj->getId(), wid, static_cast<size_t>(k)});
             }
         }
-    
-        // показать подробную инфу по одному предмету
-        void showSubjectDetails() const {
-            int subjId;
-            cout << "введите id предмета: ";
-            cin >> subjId;
-    
-            for (auto* s : subjects) {
-                if (s->getId() == subjId) {
-                    s->printFull();
-                    return;
+        for (int i = 0; i < threads * studentsPerThread; ++i) {
+            studentIds.push_back(sys.addStudent("студент " + to_string(i), "г" + to_string(i % 5))->getId());
+        }
+        for (auto& h : held) h = 0;
+
+        auto runAll = [&](auto&& body) {
+            atomic<bool> go{false};
+            vector<thread> pool;
+            for (int t = 0; t < threads; ++t) {
+                pool.emplace_back([&, t] {
+                    while (!go.load()) this_thread::yield();
+                    body(t);
+                });
+            }
+            auto start = chrono::steady_clock::now();
+            go = true;
+            for (auto& th : pool) th.join();
+            return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        };
+
+        // волна 1: все потоки одновременно пытаются занять каждый слот
+        vector<atomic<int>> wins(slots.size());
+        for (auto& w : wins) w = 0;
+        raceSec = runAll([&](int t) {
+            for (size_t k = 0; k < slots.size(); ++k) {
+                size_t i = (k + static_cast<size_t>(t) * 7) % slots.size();
+                int stud = studentIds[static_cast<size_t>(t * studentsPerThread) + k % studentsPerThread];
+                if (sys.reserveWorkOnSubject(slots[i].subjId, stud, slots[i].workId)) {
+                    ++wins[i];
+                    ++held[i];
                 }
             }
-            cout << "предмет не найден\n";
+        });
+        for (auto& w : wins) {
+            if (w > 1) ++doubleBooked;
+            if (w == 0) ++missed;
+            reserves += static_cast<size_t>(w.load());
         }
-    
-        //выгрузка итогов
-        void exportSubjectReport() const {
-            int subjId;
-            cout << "введите id предмета для отчёта: ";
-            cin >> subjId;
-        
-            for (auto* s : subjects) {
-                if (s->getId() == subjId) {
-        
-                    // Показываем отчёт в консоли
-                    cout << "==== отчёт по предмету \"" << s->getName() << "\" ====\n";
-                    s->printFull();
-                    cout << "==== конец отчёта ====\n";
-        
-                    string filename = "report_subject_" + to_string(subjId) + ".txt";
-        
-                    ofstream out(filename);
-                    if (!out) {
-                        cout << "ошибка: не удалось открыть файл для записи\n";
-                        return;
-                    }
-        
-                    // 4) Записываем данные
-                    out << "ОТЧЁТ ПО ПРЕДМЕТУ\n";
-                    out << "Название: " << s->getName() << "\n";
-                    out << "ID предмета: " << s->getId() << "\n";
-        
-                    if (s->getOwner())
-                        out << "Преподаватель: " << s->getOwner()->getName() << "\n";
-        
-                    out << "----------------------------------------\n";
-        
-                    // Студенты
-                    out << "\nСтуденты (" << s->getStudentsList().size() << "):\n";
-                    for (auto* st : s->getStudentsList()) {
-                        if (st)
-                            out << " - " << st->getName()
-                                << " (группа: " << st->getGroup() << ")\n";
+
+        // волна 2: смешанные переходы, вставки в реестр и чтение вперемешку
+        atomic<size_t> mixedReserves{0};
+        mixSec = runAll([&](int t) {
+            minstd_rand rng(static_cast<unsigned>(t + 1));
+            for (int r = 0; r < rounds; ++r) {
+                size_t i = rng() % slots.size();
+                const SlotRef& slot = slots[i];
+                int stud = studentIds[static_cast<size_t>(t * studentsPerThread) + rng() % studentsPerThread];
+                unsigned dice = rng() % 100;
+                if (dice < 35) {
+                    if (sys.reserveWorkOnSubject(slot.subjId, stud, slot.workId)) {
+                        ++held[i];
+                        ++mixedReserves;
                     }
-        
-                    // Задания
-                    out << "\nЗадания:\n";
-                    for (const auto& slot : s->getAssignmentsList()) {
-                        if (!slot.work) continue;
-        
-                        out << " * " << slot.work->getTypeName()
-                            << " \"" << slot.work->getTitle() << "\"";
-        
-                        if (!slot.reservedBy) {
-                            out << " → свободно\n";
-                        } else {
-                            out << " → студент: " << slot.reservedBy->getName();
-        
-                            if (!slot.submitted && !slot.approved)
-                                out << " | статус: записан\n";
-                            else if (slot.submitted && !slot.approved)
-                                out << " | статус: сдано, ждёт проверки\n";
-                            else if (slot.approved)
-                                out << " | оценка: " << slot.grade << "\n";
+                } else if (dice < 50) {
+                    sys.studentSubmitWork(slot.subjId, stud, slot.workId);
+                } else if (dice < 60) {
+                    sys.approveWorkOnSubject(slot.subjId, slot.workId, static_cast<int>(rng() % 11));
+                } else if (dice < 75) {
+                    if (sys.dropWorkOnSubject(slot.subjId, stud, slot.workId)) --held[i];
+                } else if (dice < 82) {
+                    if (sys.rejectWorkOnSubject(slot.subjId, slot.workId)) --held[i];
+                } else if (dice < 88) {
+                    Student* fresh = sys.addStudent("новичок", "г" + to_string(t % 5));
+                    sys.enrollStudentToSubject(slot.subjId, fresh->getId());
+                } else if (dice < 99) {
+                    sys.findStudentById(static_cast<int>(rng() % 100000));
+                    UniversitySystem::subjectStats(*sys.findSubjectById(slot.subjId));
+                } else {
+                    sys.showSubjectDetails(slot.subjId);
+                }
+            }
+        });
+        ops = static_cast<size_t>(threads) * rounds;
+        reserves += mixedReserves;
+
+        // сверка: держатель слота один, счётчики сходятся, обратный индекс указывает куда надо
+        size_t reservedSlots = 0;
+        for (size_t i = 0; i < slots.size(); ++i) {
+            Subject* subj = sys.findSubjectById(slots[i].subjId);
+            auto lock = subj->readLock();
+            int reserver = slotword::reserver(subj->slotStateAt(slots[i].index));
+            if (reserver != 0) ++reservedSlots;
+            if (held[i] != (reserver != 0 ? 1 : 0)) ++mismatched;
+        }
+        size_t refs = 0;
+        for (int id : studentIds) {
+            Student* st = sys.findStudentById(id);
+            for (const WorkRef& ref : st->getWorks()) {
+                ++refs;
+                auto lock = ref.subject->readLock();
+                if (slotword::reserver(ref.subject->slotStateAt(ref.slot)) != id) ++badRefs;
+            }
+        }
+        if (refs != reservedSlots) badRefs += refs > reservedSlots ? refs - reservedSlots : reservedSlots - refs;
+        countersOk = sys.verifyCounters(false);
+    }
+
+    bool ok = doubleBooked == 0 && missed == 0 && mismatched == 0 && badRefs == 0 && countersOk;
+    cout << "стресс-тест: потоков " << threads << ", слотов " << slots.size() << ", студентов " << studentIds.size() << "\n";
+    cout << "  гонка за слоты: двойных записей " << doubleBooked << ", незанятых слотов " << missed
+         << ", время " << static_cast<long long>(raceSec * 1000) << " мс\n";
+    cout << "  смешанная нагрузка: операций " << ops << ", успешных записей " << reserves
+         << ", время " << static_cast<long long>(mixSec * 1000) << " мс";
+    if (mixSec > 0) cout << ", " << static_cast<long long>(ops / mixSec) << " операций/с";
+    cout << "\n  сверка: расхождений по слотам " << mismatched << ", ошибок обратного индекса " << badRefs
+         << ", счётчики статусов " << (countersOk ? "сходятся" : "НЕ сходятся") << "\n";
+    cout << (ok ? "результат: всё сходится" : "результат: НАЙДЕНЫ ОШИБКИ") << "\n";
+    return ok ? 0 : 1;
+}
+
+/** @brief Бенчмарк окна записи: все потоки бьются за несколько горячих слотов */
+void runContentionBench(int maxThreads) {
+    maxThreads = max(1, maxThreads);
+    const int hotSlots = 4;
+    const auto window = chrono::milliseconds(300);
+
+    cout << "конкуренция за " << hotSlots << " слота, окно " << window.count() << " мс на замер\n";
+    for (int threads = 1; threads <= maxThreads; threads *= 2) {
+        UniversitySystem sys;
+        atomic<size_t> wins{0}, attempts{0};
+        double seconds = 0;
+        {
+            MuteCout mute;
+            Subject* subj = sys.addSubject(sys.addTeacher("бенч")->getId(), "запись на лабы");
+            vector<int> works, studs;
+            for (int k = 0; k < hotSlots; ++k) works.push_back(sys.addWorkToSubject(subj->getId(), WorkType::Lab, "лаба"));
+            for (int t = 0; t < threads; ++t) studs.push_back(sys.addStudent("студент", "г")->getId());
+
+            atomic<bool> go{false}, stop{false};
+            vector<thread> pool;
+            for (int t = 0; t < threads; ++t) {
+                pool.emplace_back([&, t] {
+                    minstd_rand rng(static_cast<unsigned>(t + 1));
+                    size_t myWins = 0, myAttempts = 0;
+                    while (!go.load()) this_thread::yield();
+                    while (!stop.load(memory_order_relaxed)) {
+                        int w = works[rng() % hotSlots];
+                        ++myAttempts;
+                        // занял - сразу отпускаем, чтобы слот снова стал добычей
+                        if (sys.reserveWorkOnSubject(subj->getId(), studs[t], w)) {
+                            ++myWins;
+                            sys.dropWorkOnSubject(subj->getId(), studs[t], w);
                         }
                     }
-        
-                    out << "\n--- конец отчёта ---\n";
-                    out.close();
-        
-                    cout << "отчёт сохранён в файл: " << filename << "\n";
-                    return;
+                    wins += myWins;
+                    attempts += myAttempts;
+                });
+            }
+            auto start = chrono::steady_clock::now();
+            go = true;
+            this_thread::sleep_for(window);
+            stop = true;
+            for (auto& th : pool) th.join();
+            seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        }
+        cout << "  потоков " << threads << ": записей " << static_cast<long long>(wins / seconds) << "/с, попыток "
+             << static_cast<long long>(attempts / seconds) << "/с, успешных "
+             << (attempts ? 100 * wins / attempts : 0) << "%\n";
+        if (threads < maxThreads && threads * 2 > maxThreads) threads = maxThreads / 2; // последний замер - ровно maxThreads
+    }
+}
+
+/** @brief Замер одной операции: время каждого вызова и выделения памяти */
+struct BenchResult {
+    string name;
+    size_t count = 0;
+    double seconds = 0;
+    size_t allocations = 0;
+    vector<uint32_t> nanos; // отсортированы
+
+    double opsPerSec() const { return seconds > 0 ? count / seconds : 0; }
+    double allocsPerOp() const { return count ? static_cast<double>(allocations) / count : 0; }
+    uint32_t percentile(double p) const {
+        return nanos.empty() ? 0 : nanos[min(nanos.size() - 1, static_cast<size_t>(p * static_cast<double>(nanos.size())))];
+    }
+};
+
+// op(i) вызывается count раз; в задержку входит и сам замер времени (десятки нс)
+template <typename Op>
+BenchResult benchOp(const string& name, size_t count, Op op) {
+    BenchResult r;
+    r.name = name;
+    r.count = count;
+    r.nanos.reserve(count);
+    size_t allocsBefore = threadAllocations;
+    auto start = chrono::steady_clock::now();
+    for (size_t i = 0; i < count; ++i) {
+        auto t0 = chrono::steady_clock::now();
+        op(i);
+        auto t1 = chrono::steady_clock::now();
+        r.nanos.push_back(static_cast<uint32_t>(min<long long>(chrono::duration_cast<chrono::nanoseconds>(t1 - t0).count(),
+                                                               numeric_limits<uint32_t>::max())));
+    }
+    r.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    r.allocations = threadAllocations - allocsBefore;
+    sort(r.nanos.begin(), r.nanos.end());
+    return r;
+}
+
+/** @brief Набор бенчмарков: синтетические университеты растущего размера, замер каждой операции */
+int runBenchmarkSuite(size_t maxStudents, const string& jsonPath) {
+    const size_t scales[] = {1000, 10000, 100000, 1000000};
+    const size_t studentsPerGroup = 25;
+    const size_t studentsPerSubject = 100;
+    const size_t subjectsPerTeacher = 2;
+    const int worksPerSubject = 8;
+    const size_t maxOps = 20000; // вызовов на дешёвую операцию
+
+    string json = "{\n  \"kernel\": \"" + string(statkernels::name()) + "\",\n  \"scales\": [";
+    bool firstScale = true;
+    for (size_t n : scales) {
+        if (n > maxStudents) break;
+        UniversitySystem sys; // в памяти, журнал не открыт
+        vector<int> studs, subjs, teachers;
+        vector<vector<int>> worksOf; // задания по позиции предмета в subjs
+        vector<BenchResult> results;
+        double buildSec = 0;
+        {
+            MuteCout mute;
+            auto start = chrono::steady_clock::now();
+            size_t subjectCount = max<size_t>(1, n / studentsPerSubject);
+            for (size_t t = 0; t < (subjectCount + subjectsPerTeacher - 1) / subjectsPerTeacher; ++t) {
+                teachers.push_back(sys.addTeacher("преподаватель " + to_string(t))->getId());
+            }
+            for (size_t s = 0; s < subjectCount; ++s) {
+                subjs.push_back(sys.addSubject(teachers[s / subjectsPerTeacher], "предмет " + to_string(s))->getId());
+                worksOf.emplace_back();
+                for (int k = 0; k < worksPerSubject; ++k) {
+                    worksOf.back().push_back(sys.addWorkToSubject(subjs.back(), k % 2 ? WorkType::Lab : WorkType::Report,
+                                                                  "задание " + to_string(k)));
                 }
             }
-            cout << "предмет не найден\n";
+            // каждый студент записан на два предмета, половина заданий занята
+            for (size_t i = 0; i < n; ++i) {
+                studs.push_back(sys.addStudent("студент " + to_string(i), "г" + to_string(i / studentsPerGroup))->getId());
+                size_t a = i % subjectCount, b = (i * 7 + 3) % subjectCount;
+                sys.enrollStudentToSubject(subjs[a], studs.back());
+                if (b != a) sys.enrollStudentToSubject(subjs[b], studs.back());
+                size_t k = (i / subjectCount) % worksPerSubject;
+                if (k % 2 == 0) sys.reserveWorkOnSubject(subjs[a], studs.back(), worksOf[a][k]);
+            }
+            buildSec = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+            size_t ops = min(n, maxOps);
+            size_t heavy = max<size_t>(1, ops / 20);
+            minstd_rand rng(42);
+            auto anyStudent = [&] { return studs[rng() % studs.size()]; };
+            auto anySubject = [&] { return rng() % subjs.size(); };
+
+            results.push_back(benchOp("findStudentById", ops, [&](size_t) { sys.findStudentById(anyStudent()); }));
+            results.push_back(benchOp("findSubjectById", ops, [&](size_t) { sys.findSubjectById(subjs[anySubject()]); }));
+
+            // новые студенты проходят весь путь: запись на предмет, своё задание, сдача, оценка
+            vector<int> fresh(ops), freshWorks(ops);
+            vector<size_t> freshSubj(ops);
+            results.push_back(benchOp("addStudent", ops, [&](size_t i) {
+                fresh[i] = sys.addStudent("новый студент", "г" + to_string(i / studentsPerGroup))->getId();
+            }));
+            results.push_back(benchOp("enrollStudentToSubject", ops, [&](size_t i) {
+                freshSubj[i] = anySubject();
+                sys.enrollStudentToSubject(subjs[freshSubj[i]], fresh[i]);
+            }));
+            results.push_back(benchOp("addWorkToSubject", ops, [&](size_t i) {
+                freshWorks[i] = sys.addWorkToSubject(subjs[freshSubj[i]], WorkType::Lab, "лаба");
+            }));
+            results.push_back(benchOp("reserveWorkOnSubject", ops, [&](size_t i) {
+                sys.reserveWorkOnSubject(subjs[freshSubj[i]], fresh[i], freshWorks[i]);
+            }));
+            results.push_back(benchOp("studentSubmitWork", ops, [&](size_t i) {
+                sys.studentSubmitWork(subjs[freshSubj[i]], fresh[i], freshWorks[i]);
+            }));
+            results.push_back(benchOp("approveWorkOnSubject", ops, [&](size_t i) {
+                sys.approveWorkOnSubject(subjs[freshSubj[i]], freshWorks[i], static_cast<int>(i % 11));
+            }));
+            results.push_back(benchOp("rejectWorkOnSubject", ops / 2, [&](size_t i) {
+                sys.rejectWorkOnSubject(subjs[freshSubj[2 * i]], freshWorks[2 * i]);
+            }));
+            results.push_back(benchOp("dropWorkOnSubject", ops / 2, [&](size_t i) {
+                sys.dropWorkOnSubject(subjs[freshSubj[2 * i + 1]], fresh[2 * i + 1], freshWorks[2 * i + 1]);
+            }));
+
+            results.push_back(benchOp("showStudentActivity", ops, [&](size_t) { sys.showStudentActivity(anyStudent()); }));
+            results.push_back(benchOp("subjectStats", ops, [&](size_t) {
+                UniversitySystem::subjectStats(*sys.findSubjectById(subjs[anySubject()]));
+            }));
+            results.push_back(benchOp("showSubjectDetails", heavy, [&](size_t) { sys.showSubjectDetails(subjs[anySubject()]); }));
+            // выгрузка пишет файлы в текущий каталог: на время замера уходим во временный,
+            // чтобы не перезаписать отчёты в каталоге с настоящими данными
+            string scratch;
+            int home = ::open(".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            if (home >= 0 && makeScratchDir(scratch) && chdir(scratch.c_str()) == 0) {
+                size_t exportSubjects = min<size_t>(subjs.size(), 8);
+                results.push_back(benchOp("exportSubjectReport", min<size_t>(heavy, 200), [&](size_t i) {
+                    sys.exportSubjectReport(subjs[i % exportSubjects], ReportFormat::Json, true);
+                }));
+                if (fchdir(home) != 0) return 1;
+            }
+            if (!scratch.empty()) removeScratchDir(scratch);
+            if (home >= 0) ::close(home);
+            results.push_back(benchOp("showGroupStats", 20, [&](size_t) {
+                sys.groupStats("г" + to_string(rng() % (n / studentsPerGroup + 1)));
+            }));
+            results.push_back(benchOp("universityStats", 20, [&](size_t) { sys.universityStats(); }));
+            results.push_back(benchOp("subjectSummary", ops, [&](size_t) {
+                sys.findSubjectById(subjs[anySubject()])->summary();
+            }));
+            results.push_back(benchOp("universitySummary", ops, [&](size_t) { sys.universitySummary(); }));
+            // подстрока посреди имени и начало названия группы: совпадений несколько, а документов - все
+            results.push_back(benchOp("searchSubstring", ops, [&](size_t) {
+                sys.search("дент " + to_string(rng() % n), false);
+            }));
+            results.push_back(benchOp("searchPrefix", ops, [&](size_t) {
+                sys.search("г" + to_string(rng() % (n / studentsPerGroup + 1)), true);
+            }));
         }
-        
-        ~UniversitySystem() {
-            // удаляем студентов
-            for (auto* s : students)
-                delete s;
-        
-            // удаляем преподавателей
-            for (auto* t : teachers)
-                delete t;
-        
-            // удаляем предметы 
-            for (auto* sub : subjects)
-                delete sub;
+
+        cout << "масштаб: студентов " << n << ", предметов " << subjs.size() << ", преподавателей " << teachers.size()
+             << ", построение " << static_cast<long long>(buildSec * 1000) << " мс\n";
+        sys.showStringStats();
+        json += string(firstScale ? "" : ",") + "\n    {\"students\": " + to_string(n) + ", \"subjects\": " +
+                to_string(subjs.size()) + ", \"teachers\": " + to_string(teachers.size()) + ", \"build_ms\": " +
+                to_string(static_cast<long long>(buildSec * 1000)) + ", \"ops\": [";
+        firstScale = false;
+        for (size_t k = 0; k < results.size(); ++k) {
+            const BenchResult& r = results[k];
+            char allocs[32];
+            snprintf(allocs, sizeof(allocs), "%.2f", r.allocsPerOp());
+            cout << "  " << r.name << ": вызовов " << r.count << ", " << static_cast<long long>(r.opsPerSec())
+                 << " опер/с, p50 " << r.percentile(0.50) << " нс, p99 " << r.percentile(0.99)
+                 << " нс, выделений на операцию " << allocs << "\n";
+            json += string(k ? "," : "") + "\n      {\"name\": \"" + r.name + "\", \"count\": " + to_string(r.count) +
+                    ", \"ops_per_sec\": " + to_string(static_cast<long long>(r.opsPerSec())) +
+                    ", \"p50_ns\": " + to_string(r.percentile(0.50)) + ", \"p90_ns\": " + to_string(r.percentile(0.90)) +
+                    ", \"p99_ns\": " + to_string(r.percentile(0.99)) + ", \"max_ns\": " +
+                    to_string(r.nanos.empty() ? 0 : r.nanos.back()) + ", \"allocs_per_op\": " + allocs + "}";
         }
-        
-    };
-    
+        json += "\n    ]}";
+        cout.flush();
+    }
+    json += "\n  ]\n}\n";
+
+    if (!UniversitySystem::writeWholeFile(jsonPath, json)) {
+        cout << "ошибка: не удалось записать " << jsonPath << "\n";
+        return 1;
+    }
+    cout << "результаты сохранены в файл: " << jsonPath << "\n";
+    return 0;
+}
+
     void printMenu() {
         cout << "\n=== меню ===\n";
         cout << "1 - добавить преподавателя\n";
@@ -894,17 +6087,104 @@ class UniversitySystem {
         cout << "15 - список преподавателей\n";
         cout << "16 - преподаватели по предметам\n";
         cout << "17 - активность студента\n";
+        cout << "18 - записать группу на предмет\n";
+        cout << "19 - сохранить снимок\n";
+        cout << "20 - импорт из CSV\n";
+        cout << "21 - выгрузка отчётов по всем предметам\n";
+        cout << "22 - статистика памяти\n";
+        cout << "23 - статистика оценок\n";
+        cout << "24 - метрики\n";
+        cout << "25 - список групп\n";
+        cout << "26 - активность группы\n";
+        cout << "27 - сводка по статусам слотов\n";
+        cout << "28 - поиск\n";
         cout << "0 - выход\n";
         cout << "выберите пункт: ";
     }
     
-    int main() {
+    int main(int argc, char* argv[]) {
         setlocale(LC_ALL, "ru_RU.utf8");
+        ios::sync_with_stdio(false); // stdio не используем, cin читает своим буфером
+
+        // проверка конкурентного ядра: --stress [потоков]
+        if (argc > 1 && string(argv[1]) == "--stress") {
+            return runStressTest(argc > 2 ? atoi(argv[2]) : 32);
+        }
+        // рост числа успешных записей на горячих слотах с числом потоков: --contention [потоков]
+        if (argc > 1 && string(argv[1]) == "--contention") {
+            runContentionBench(argc > 2 ? atoi(argv[2]) : 64);
+            return 0;
+        }
+
+        // мягкая остановка --serve по SIGINT/SIGTERM со всеми потоками: --shutdown-test
+        if (argc > 1 && string(argv[1]) == "--shutdown-test") {
+            return runShutdownTest();
+        }
+
+        // генератор нагрузки для сервера: --loadgen [сокет] [соединений] [запросов на соединение] [конвейер]
+        if (argc > 1 && string(argv[1]) == "--loadgen") {
+            return runLoadGen(argc > 2 ? argv[2] : SERVER_SOCKET, argc > 3 ? atoi(argv[3]) : 8,
+                              argc > 4 ? atoi(argv[4]) : 10000, argc > 5 ? atoi(argv[5]) : 16);
+        }
+
+        // бенчмарки всех операций на синтетических данных: --bench [максимум студентов] [файл json]
+        if (argc > 1 && string(argv[1]) == "--bench") {
+            return runBenchmarkSuite(argc > 2 ? strtoull(argv[2], nullptr, 10) : 1000000, argc > 3 ? argv[3] : "bench.json");
+        }
+
+        // сервер ловит SIGINT/SIGTERM через signalfd: блокируем их раньше, чем система и сброс метрик заведут потоки
+        bool serving = argc > 1 && string(argv[1]) == "--serve";
+        if (serving) blockShutdownSignals();
+
+        // дальше весь вывод буферизуется; объявлен раньше sys, чтобы пережить его деструктор
+        OutputSink sink;
+        // тихий интерактивный режим: без меню и подтверждений операций
+        bool quiet = argc > 1 && string(argv[1]) == "--quiet";
+        quietOutput = quiet;
+
         UniversitySystem sys;
+        sys.loadOnStartup();
+#if UNI_METRICS
+        MetricsDumper metricsDump(METRICS_FILE, chrono::seconds(METRICS_DUMP_SECONDS));
+#endif
+
+        // сервер запросов: --serve [сокет] [воркеров], строки запросов - команды пакетного режима
+        if (serving) {
+            int workers = argc > 3 ? atoi(argv[3]) : max(2, static_cast<int>(thread::hardware_concurrency()));
+            RoutedOutput routed(cout.rdbuf());
+            streambuf* saved = cout.rdbuf(&routed);
+            bool ok;
+            {
+                RequestServer server(sys, argc > 2 ? argv[2] : SERVER_SOCKET);
+                ok = server.run(workers);
+            }
+            cout.rdbuf(saved);
+            sys.saveSnapshotMenu();
+            return ok ? 0 : 1;
+        }
+
+        // пакетный режим: --batch <файл> или --batch - для stdin
+        if (argc > 1 && string(argv[1]) == "--batch") {
+            BatchRunner runner(sys);
+            size_t errors = 0;
+            string path = argc > 2 ? argv[2] : "-";
+            if (path == "-") {
+                errors = runner.run(cin);
+            } else {
+                ifstream script(path);
+                if (!script) {
+                    cout << "ошибка: не удалось открыть файл команд " << path << "\n";
+                    return 1;
+                }
+                errors = runner.run(script);
+            }
+            sys.saveSnapshotMenu();
+            return errors == 0 ? 0 : 2;
+        }
     
         int choice = -1;
         while (true) {
-            printMenu();
+            if (!quiet) printMenu();
             cin >> choice;
     
             if (!cin) {
@@ -915,6 +6195,7 @@ class UniversitySystem {
             }
     
             if (choice == 0) {
+                sys.saveSnapshotMenu();
                 cout << "выход из программы\n";
                 break;
             }
@@ -971,10 +6252,49 @@ class UniversitySystem {
             case 17:
                 sys.showStudentActivity();
                 break;
+            case 18:
+                sys.enrollGroupToSubject();
+                break;
+            case 19:
+                sys.saveSnapshotMenu();
+                break;
+            case 20:
+                sys.importCsvMenu();
+                break;
+            case 21:
+                sys.exportAllReportsMenu();
+                break;
+            case 22:
+                sys.showMemoryStats();
+                break;
+            case 23:
+                sys.statsMenu();
+                break;
+            case 24:
+                metrics::printReport();
+                break;
+            case 25:
+                sys.listGroups();
+                break;
+            case 26:
+                sys.showGroupActivity();
+                break;
+            case 27:
+                sys.showSummary();
+                break;
+            case 28:
+                sys.searchMenu();
+                break;
             default:
                 cout << "нет такого пункта\n";
                 break;
             }
+#if UNI_VERIFY_COUNTERS
+            sys.verifyCounters(false);
+#endif
+            sys.commitJournal();
+            sys.maybeCompact();
+            OutputSink::flush(); // команда выполнена - её вывод виден сразу
         }
     
         return 0;